@@ -3,12 +3,20 @@
 
 #include<iostream>
 #include<vector>
+#include<unordered_map>
+#include<cstdint>
+#include<memory>
+#include "tagMatch.h"
+#include "cacheKernel.h"
+#include "fullyAssociativeSet.h"
+#include "replacementPolicy.h"
+#include "setPageTable.h"
 using namespace std;
 
 class CacheBlock
 {
 public:
-    uint32_t tag;
+    uint64_t tag;
     bool valid_bit;
     bool dirty_bit;
     int lru_counter;
@@ -26,6 +34,7 @@ struct CacheStatistics
     int n_swap_requests = 0;
     int n_swaps = 0;       // between L1, VC
     int n_writebacks = 0;  // # of writebacks from Li or its VC(if enabled) to next level
+    int n_back_invalidations = 0;  // blocks of Li (+VC) invalidated by the evictions of an inclusive lower level
     float hitTime = 0;
     float energy = 0;
     float area = 0;
@@ -34,6 +43,30 @@ struct CacheStatistics
     // CacheStatistics() {vc_statistics = new CacheStatistics();}
 };
 
+enum class AccessType {READ, WRITE};
+
+/*
+ * @brief A block leaving a cache (for L1 + VC: the block leaving both)
+ */
+struct EvictedBlock
+{
+    long long int addr = 0;
+    bool isValid = false;
+    bool isDirty = false;   // only if valid
+};
+
+/*
+ * @brief Outcome of Cache::access, trivially copyable: set and tag are computed once and blocks stay in place
+ */
+struct AccessResult
+{
+    bool isHit;             // in the cache, or swapped in from its VC
+    int set_num;
+    int idx;                // hit: way of the block, miss: way to fill, -1 if the VC took the victim of the way
+    long long int tag;
+    EvictedBlock victim;    // idx -1: the block the VC evicted to take the victim
+};
+
 /**
  * @brief Set-Associative Cache
  */
@@ -51,10 +84,72 @@ private:
     uint n_tagBits;
     uint n_indexBits;
     uint n_blockOffsetBits; 
-    vector<vector<CacheBlock>> cache;
+
+    /*
+     * Every set is one record of a set page table (a page of sets is allocated when one of them is first touched,
+     * sets never touched are invalid), so an access finds all of a set in one lookup. A record is the tags of the
+     * set (way i is element i, contiguous and aligned), then its valid bitmask and its dirty bitmask, n_maskWords
+     * words each, padded so that the next record's tags stay aligned. The replacement state is kept by the policy.
+     */
+    uint tag_stride;        // assoc rounded up to TAG_MATCH_VECTOR_WAYS (padding ways are never valid)
+    uint n_maskWords;       // 64-bit words of the valid / dirty bitmask of a set
+    SetPageTable<uint64_t, CACHE_LINE_SIZE> sets;
+
+    // assoc >= FA_ENGINE_MIN_ASSOC: hash index of the tags of every set (O(1) lookup), n_indexSlots slots per set
+    bool isTagIndexed;
+    uint n_indexSlots;
+    SetPageTable<FullyAssociativeSlot> tag_indexes;
+
+    FullyAssociativeSet getTagIndex(int set_num) {return FullyAssociativeSet(tag_indexes.getSet(set_num), n_indexSlots);}
+
+    ReplacementPolicyKind policy_kind;
+    ReplacementPolicy replacement;
+
+    uint64_t* getSetTags(int set_num) {return sets.getSet(set_num);}
+    uint64_t* getValidBits(int set_num) {return sets.getSet(set_num) + tag_stride;}
+    uint64_t* getDirtyBits(int set_num) {return sets.getSet(set_num) + tag_stride + n_maskWords;}
+
+    static bool getBit(const uint64_t* bits, int idx) {return (bits[idx / 64] >> (idx % 64)) & 1;}
+
+    static void setBit(uint64_t* bits, int idx, bool value)
+    {
+        uint64_t& word = bits[idx / 64];
+        word = (word & ~(1ULL << (idx % 64))) | ((uint64_t) value << (idx % 64));
+    }
+
+    bool isBlockValid(int set_num, int idx) {return getBit(getValidBits(set_num), idx);}
+
+    /*
+     * @brief Marks a way invalid in place (its tag and dirty bit are overwritten by the next fill)
+     */
+    void clearValid(int set_num, int idx);
+
+    /*
+     * @return way of the valid block `tag` in the set, -1 if none (no replacement state or counter changes)
+     */
+    int findWay(int set_num, long long int tag);
+
+    /*
+     * @brief Invalidates the block of `addr` in this cache or its VC
+     * @return the block before invalidation (valid_bit false if it was in neither)
+     */
+    CacheBlock invalidateAddress(long long int addr);
+
+    /*
+     * @brief Gathers / scatters the fields of one block (storeBlock keeps the replacement state of the position)
+     */
+    CacheBlock readBlock(int set_num, int idx);
+    void storeBlock(int set_num, int idx, const CacheBlock& block);
 
     CacheStatistics c_stats;
 
+    // Misses attributed to the PC of the demand access (only when enabled, accesses without a PC are not counted)
+    bool isPCStatsEnabled;
+    unordered_map<uint64_t, uint> pc_misses;
+
+    // Functional warming: blocks and replacement state evolve, no event is counted (see setWarming)
+    bool isWarming;
+
     /*
      * @brief It checks for cache_block only in its cache_set but not its VC
      * @return
@@ -62,24 +157,46 @@ private:
      * @return 
      *   - When returned bool=false(lookup - miss), int=index of `invalid block` if exists, else `lru block` index
      */
-    pair<bool, int> lookupBlock(int set_num, long long int tag);      
+    template<typename Kernel = GenericCacheKernel>
+    pair<bool, int> lookupBlock(int set_num, long long int tag);
 
     /*
-     * @brief Finds LRU Block or Invalid block in the cache_set
-     * @param set_num  set number in which LRU/invalid block has to be found
+     * @brief Finds the block the replacement policy evicts next from the cache_set
+     * @param set_num  set number in which the victim has to be found
      * @return 
-     * - If there exits an `invalid` block, then it returns index of invalid cache block
+     * - LRU: LRU block index (invalid blocks start as the LRU blocks)
      * 
-     * - Else LRU block index
+     * - Other policies: index of an `invalid` block if one exists, else the policy's victim
      */
-    int findLRUBlock(int set_num);
+    template<typename Kernel = GenericCacheKernel>
+    int findLRUBlock(int set_num)
+    {
+        const uint64_t* set_valid_bits = getValidBits(set_num);
+        return visit([set_num, set_valid_bits] (auto& policy)
+        {
+            if constexpr(is_same_v<decay_t<decltype(policy)>, LRUPolicy>)
+                return policy.template findVictim<Kernel::N_WAYS>(set_num, set_valid_bits);
+            else
+                return policy.findVictim(set_num, set_valid_bits);
+        }, replacement);
+    }
 
     /*
-     * @brief Increments the lru counters of all `valid` cache_blocks in the cache_set
+     * @brief Tells the replacement policy that block `idx` was accessed (LRU: it becomes the MRU block)
      * 
      * @param set_num set number of cache_set 
      */
-    void incrementLRUCounters(int set_num, int idx);
+    template<typename Kernel = GenericCacheKernel>
+    void promoteBlock(int set_num, int idx)
+    {
+        visit([set_num, idx] (auto& policy)
+        {
+            if constexpr(is_same_v<decay_t<decltype(policy)>, LRUPolicy>)
+                policy.template promote<Kernel::N_WAYS>(set_num, idx);
+            else
+                policy.onHit(set_num, idx);
+        }, replacement);
+    }
 
     /*
      * @brief Swapping blocks between L1 and its victim cache(VC)
@@ -93,46 +210,79 @@ private:
     void findCactiCacheStatistics();
 
 public:
-    Cache* vc_cache;
+    unique_ptr<Cache> vc_cache;
     void printCacheSet(int set_num);
     Cache();
 
     /*
+     * @param arena where the sets of this cache and its VC are allocated (reserved here, see MetadataArena)
      * @param n_vc_blocks number of victim cache blocks (If 0 => Victim Cache is disabled)
+     * @param policy_kind replacement policy of this cache and its VC
+     */
+    Cache(MetadataArena* arena, int cache_size, int assoc, int block_size, int n_vc_blocks,
+          ReplacementPolicyKind policy_kind = ReplacementPolicyKind::LRU);
+
+    // A cache owns its sets and its VC: caches are moved, never copied
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+    Cache(Cache&&) = default;
+    Cache& operator=(Cache&&) = default;
+
+    /*
+     * @brief CACTI hit time, energy and area of a cache geometry (hit time 0.2 if CACTI fails), memoized on disk (see CactiMemo)
      */
-    Cache(int cache_size, int assoc, int block_size, int n_vc_blocks);
+    static void findCactiResults(uint cache_size, uint block_size, uint assoc, float& hitTime, float& energy, float& area);
 
-    int getSetNumber(long long int addr);
-    long long int getTag(long long int addr);
-    long long int getBlockAddress(int set_num, long long int tag);
+    /*
+     * Kernel: CacheKernel of this cache's associativity and block size (constexpr shifts), or the generic one
+     */
+    template<typename Kernel = GenericCacheKernel>
+    int getSetNumber(long long int addr) {return Kernel::getSetNumber(addr, n_blockOffsetBits, n_indexBits);}
+
+    template<typename Kernel = GenericCacheKernel>
+    long long int getTag(long long int addr) {return Kernel::getTag(addr, n_blockOffsetBits, n_indexBits);}
+
+    template<typename Kernel = GenericCacheKernel>
+    long long int getBlockAddress(int set_num, long long int tag)
+    {
+        return Kernel::getBlockAddress(set_num, tag, n_blockOffsetBits, n_indexBits);
+    }
     
-    /*  @brief Reads the block at given addr 
-     *  @return 
-     *  1. When returned bool=false(read - miss):
-     * 
-     *  int = index of LRU/invalid cache block that should be evicted to allocate new block
-     * 
-     *  2. When returned bool=true(read - hit):
-     *    
-     *  int = index of cache block found in corresponding cache set
-    */
-    pair<bool, pair<int, CacheBlock>> lookupRead(long long int addr);
-
-    /* 
-     *  @brief Writes data to the block at given addr
-     *  @return 
-     *  1. When returned bool=false(write miss):
-     * 
-     *  int = index of LRU/invalid cache block that should be evicted to allocate new block
-     * 
-     *  2. When returned bool=true(write - hit):
-     * 
-     *  int = index of cache block found in corresponding cache set
-    */
-    pair<bool, pair<int, CacheBlock>> lookupWrite(long long int addr);
+    /*
+     * @brief Reads or writes the block at `addr` (`pc` is the program counter of the access, 0 if unknown)
+     *
+     * A hit promotes the block, a write hit also dirties it. On a miss of a valid way the VC is asked: its hit swaps
+     * the block in (a hit of the pair), its miss takes the victim of the way. Otherwise a miss only picks the way the
+     * caller fills (see fill), invalid ways first.
+     */
+    template<AccessType TYPE, typename Kernel = GenericCacheKernel>
+    AccessResult access(long long int addr, uint64_t pc = 0);
 
-    // NOTE: lookupRead and lookupWrite are actually doing the same as they are not really reading/write in this function
-    // Considered into two for now so that no of read misses etc.. can be counted seperately
+    /*
+     * @brief Software prefetch of the metadata (tags, state bits, replacement state) of the set of `addr`, so that
+     *        a later access finds it in the CPU caches. No simulated state changes, untouched sets are skipped.
+     */
+    template<typename Kernel = GenericCacheKernel>
+    void prefetchSet(long long int addr) const
+    {
+        int set_num = Kernel::getSetNumber(addr, n_blockOffsetBits, n_indexBits);
+        sets.prefetchSet(set_num);
+        visit([set_num] (const auto& policy) {policy.prefetchSet(set_num);}, replacement);
+    }
+
+    /*
+     * @brief Places the block missed by `result`, dirty if `isDirty`
+     * @return the block leaving the cache: the one replaced, or the one the VC evicted for the victim
+     */
+    template<typename Kernel = GenericCacheKernel>
+    EvictedBlock fill(const AccessResult& result, bool isDirty);
+
+    /*
+     * @brief Places block `tag` in way `idx` of the set, evicting its block (counted as a writeback if dirty)
+     * @param idx way to fill if known, else -1 (the replacement policy's victim, invalid ways first)
+     */
+    template<typename Kernel = GenericCacheKernel>
+    EvictedBlock fillBlock(int set_num, int idx, long long int tag, bool isDirty);
 
     // void readData(int set_num, int idx);
 
@@ -142,22 +292,6 @@ public:
     void writeData(int set_num, int idx);
 
     CacheBlock getBlock(int set_num, int idx);
-    
-    /*
-     * @brief Evicts the LRU/invalid block to place new_block in the cache_set.  
-        
-        (LRU counters are not incremented)
-     * 
-     * - If there exists an `invalid` block in the cache_set, it considers to replace with invalid block. 
-     * 
-     * - Else lru block.
-     * 
-     * @param incoming_cache_block new block which needs to replace LRU/invalid block
-     * @param set_num set number in which replacement happens
-     * @param idx index of LRU/invalid block in the cache_set if known else give -1
-     * @return LRU/Invalid cache block that's evicted from the cache
-     */
-    CacheBlock evictAndReplaceBlock(CacheBlock incoming_cache_block, int set_num, int lru_idx);
 
 
     // /*
@@ -186,7 +320,68 @@ public:
      */
     CacheStatistics getCacheStatistics() {return c_stats;}
 
+    /*
+     * @brief Overwrites the event counters (hit time, energy, area and the VC statistics link are kept)
+     */
+    void setCacheStatistics(const CacheStatistics& stats);
+
+    /*
+     * @brief Starts counting misses per PC (also in the VC)
+     */
+    void enablePCStatistics();
+    const unordered_map<uint64_t, uint>& getPCMisses() {return pc_misses;}
+
+    /*
+     * @brief Stops (or resumes) counting events and per-PC misses (also in the VC), the blocks keep evolving
+     */
+    void setWarming(bool isWarming);
+
     void unsetDirty(int set_num, int idx);
+
+    bool isBlockDirty(int set_num, int idx) {return getBit(getDirtyBits(set_num), idx);}
+
+    /*
+     * @brief Marks the block of `addr` dirty, if this cache or its VC holds it
+     */
+    void setDirty(long long int addr);
+
+    /*
+     * @brief Invalidates a block without writing it back (its way is the next one the policy fills)
+     */
+    void invalidateBlock(int set_num, int idx);
+
+    /*
+     * @brief Back-invalidation by an inclusive lower level that evicts the block of `addr` (this cache or its VC)
+     * @return the invalidated block (valid_bit false if it was not cached), its dirty data has to be written back
+     */
+    CacheBlock backInvalidate(long long int addr);
+
+    /*
+     * @brief Counts a writeback this cache did not see in an eviction (dirty data of an upper level it passes down)
+     */
+    void addWriteback() {if(!isWarming) c_stats.n_writebacks++;}
+
+    /*
+     * @brief Counts a write that needs no lookup (a victim an exclusive upper level places here)
+     */
+    void addWrite() {if(!isWarming) c_stats.n_writes++;}
+
+    uint getSetCount() {return n_sets;}
+
+    /*
+     * @return bytes of the tags and state bits of all sets, touched or not (the replacement state is not counted)
+     */
+    size_t getSetTableBytes() const {return sets.getCapacityBytes();}
+
+    /*
+     * @brief Copies the blocks (tags, dirty bits, LRU order) of set `set_num` of a cache with the same geometry
+     */
+    void copySet(const Cache& other, int set_num);
+
+    /*
+     * @brief Adds the per-PC misses of another cache to this one
+     */
+    void addPCMisses(const unordered_map<uint64_t, uint>& other_pc_misses);
 };
 
 #endif
\ No newline at end of file
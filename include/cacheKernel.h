@@ -0,0 +1,74 @@
+#ifndef CACHE_KERNEL_H
+#define CACHE_KERNEL_H
+
+#include<cstdint>
+#include<utility>
+#include "tagMatch.h"
+using namespace std;
+
+// Associativity x block size points with a specialized kernel, X(assoc, block_size) for each of them
+#define CACHE_KERNEL_GRID(X) \
+    X(1, 16) X(1, 32) X(1, 64) X(1, 128) \
+    X(2, 16) X(2, 32) X(2, 64) X(2, 128) \
+    X(4, 16) X(4, 32) X(4, 64) X(4, 128) \
+    X(8, 16) X(8, 32) X(8, 64) X(8, 128) \
+    X(16, 16) X(16, 32) X(16, 64) X(16, 128)
+
+
+/*
+ * @brief Address split and tag match of a cache of ASSOC ways and BLOCK_SIZE-byte blocks.
+ *
+ * The block offset is a constexpr shift and the tag match compares the ASSOC ways of a set in one unrolled
+ * expression (the valid bits of a set are one word). CacheKernel<0, 0> is the generic kernel of any geometry:
+ * shifts from the cache fields and the SIMD scan of findMatchingWay.
+ */
+template<uint ASSOC, uint BLOCK_SIZE>
+struct CacheKernel
+{
+    static constexpr uint N_WAYS = ASSOC;       // 0: runtime associativity
+    static constexpr bool isGeneric = (ASSOC == 0);
+
+    static uint getBlockOffsetBits(uint n_blockOffsetBits)
+    {
+        if constexpr(BLOCK_SIZE == 0) return n_blockOffsetBits;
+        else return __builtin_ctz(BLOCK_SIZE);
+    }
+
+    static int getSetNumber(long long int addr, uint n_blockOffsetBits, uint n_indexBits)
+    {
+        long long int mask = (1 << n_indexBits) - 1;
+        return (addr >> getBlockOffsetBits(n_blockOffsetBits)) & mask;
+    }
+
+    static long long int getTag(long long int addr, uint n_blockOffsetBits, uint n_indexBits)
+    {
+        return (addr >> getBlockOffsetBits(n_blockOffsetBits)) >> n_indexBits;
+    }
+
+    static long long int getBlockAddress(int set_num, long long int tag, uint n_blockOffsetBits, uint n_indexBits)
+    {
+        uint offset_bits = getBlockOffsetBits(n_blockOffsetBits);
+        return ((tag << offset_bits) << n_indexBits) | (set_num << offset_bits);
+    }
+
+    /*
+     * @brief Way of a set holding `tag` (valid), -1 if none (arguments as in ::findMatchingWay)
+     */
+    static int findMatchingWay(const uint64_t* tags, const uint64_t* valid_bits, uint n_ways, uint64_t tag)
+    {
+        if constexpr(ASSOC == 0) return ::findMatchingWay(tags, valid_bits, n_ways, tag);
+        else return matchWays(tags, valid_bits[0], tag, make_index_sequence<ASSOC>());
+    }
+
+private:
+    template<size_t... WAYS>
+    static int matchWays(const uint64_t* tags, uint64_t valid, uint64_t tag, index_sequence<WAYS...>)
+    {
+        uint64_t matches = (((uint64_t)(tags[WAYS] == tag) << WAYS) | ...) & valid;
+        return (matches != 0) ? __builtin_ctzll(matches) : -1;
+    }
+};
+
+typedef CacheKernel<0, 0> GenericCacheKernel;
+
+#endif
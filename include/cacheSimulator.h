@@ -5,8 +5,67 @@
 #include<vector>
 #include "cache.h"
 #include "trace.h"
+#include "setSampling.h"
+#include "filterTrace.h"
+#include "levelPipeline.h"
+#include<memory>
 using namespace std;
 
+// Accesses ahead of the current one whose L1 / L2 set metadata sendRequests prefetches (0: no prefetching)
+#define REQUEST_PREFETCH_DISTANCE 8
+// Set metadata smaller than this (a level's set table, or all the sets touched so far) stays in the host's caches:
+// it is not prefetched
+#define REQUEST_PREFETCH_MIN_BYTES (1024 * 1024)
+
+
+/*
+ * @brief How the contents of the levels below L1 relate to the levels above them
+ *
+ * NINE: non-inclusive non-exclusive, levels fill on misses and receive writebacks, evictions stay local.
+ * INCLUSIVE: as NINE, and a level that evicts a block back-invalidates it in every level above (L1 with its VC).
+ * EXCLUSIVE: a block is in one level only: hits below L1 move the block up, the victims of every level (clean or
+ *            dirty) move one level down, misses are filled into L1 only.
+ */
+enum class InclusionPolicy
+{
+    NINE,
+    INCLUSIVE,
+    EXCLUSIVE
+};
+
+/*
+ * @brief Maps nine, inclusive or exclusive to its InclusionPolicy
+ * @return false if the name is unknown
+ */
+bool parseInclusionPolicy(const string& name, InclusionPolicy& inclusion);
+
+const char* getInclusionPolicyName(InclusionPolicy inclusion);
+
+
+/*
+ * @brief Size and associativity of a level below L2 (block size and replacement policy are those of L1)
+ */
+struct LevelGeometry
+{
+    uint size;
+    uint assoc;
+};
+
+
+/*
+ * @brief Counts of one level below L1
+ */
+struct LevelRawStatistics
+{
+    uint reads = 0;
+    uint read_misses = 0;
+    uint writes = 0;
+    uint write_misses = 0;
+    double miss_rate = 0;
+    uint writebacks = 0;
+    uint back_invalidations = 0;    // of its blocks, by inclusive levels below it
+};
+
 
 struct RawStatistics
 {
@@ -19,16 +78,23 @@ struct RawStatistics
     uint n_swaps;       // between L1, VC
     double l1_vc_miss_rate;   // combined L1+VC miss rate
     uint l1_writebacks;  // number of writebacks from L1 or its VC(if enabled) to next level
-    
-    uint l2_reads; 
-    uint l2_read_misses;
-    uint l2_writes;
-    uint l2_write_misses; 
-    double l2_miss_rate;   
-    uint l2_writebacks;
+    uint l1_back_invalidations;
+
+    vector<LevelRawStatistics> lower_levels;    // L2, L3, ...
 
     int total_memory_traffic;
 
+    // Accesses with a size that straddle block boundaries, split into one request per block
+    uint n_split_accesses;
+    uint n_split_requests;     // requests made for them beyond the first block
+
+    InclusionPolicy inclusion = InclusionPolicy::NINE;
+
+    /*
+     * @return statistics of L2 (i = 0), L3 (i = 1), ..., all 0 for a level the hierarchy does not have
+     */
+    LevelRawStatistics getLowerLevel(size_t i) const {return (i < lower_levels.size()) ? lower_levels[i] : LevelRawStatistics();}
+
     void printStats();
 };
 
@@ -50,42 +116,293 @@ struct SimulationStatistics
 };
 
 
+/*
+ * @brief Event counters of every level, the inputs of RawStatistics
+ */
+struct HierarchyCounters
+{
+    vector<CacheStatistics> level_stats;    // L1, L2, ...
+    CacheStatistics vc_stats;
+    uint n_split_accesses = 0;
+    uint n_split_requests = 0;
+};
+
+
 class CacheSimulator
 {
 private:
-    Cache l1_cache;
-    Cache l2_cache;
+    // Sets of every level, declared before the levels so that it outlives them
+    unique_ptr<MetadataArena> arena;
+    vector<Cache> levels;       // L1 (with the VC), L2, ...
     bool isVCEnabled;
     bool isL2Exist;
     uint l1_size, l1_assoc, l1_blocksize, n_vc_blocks, l2_size, l2_assoc;
+    vector<LevelGeometry> deeper_levels;    // L3, ...
+    ReplacementPolicyKind policy_kind;
+    InclusionPolicy inclusion;
     SimulationStatistics simulation_stats;
     string trace_file_name;
+    uint n_split_accesses;
+    uint n_split_requests;
+
+    // Set sampling: only the accesses of the sampled set groups are simulated
+    bool isSetSamplingEnabled;
+    SetSampler set_sampler;
+
+    void recordSampledAccess(long long int addr);
+
+    /*
+     * @brief Smallest set count of the hierarchy: a set group of it covers whole sets of every level
+     *
+     * Caches index with log2(sets) bits, so a set count that is not a power of two counts as the power of two below it.
+     */
+    uint findSetGroupCount();
+
+    // Set partition (a shard of sendRequestsSetPartitioned): only the set groups with `group % n_partitions == partition` are simulated
+    bool isSetPartitioned;
+    uint n_set_groups;
+    uint n_partitions;
+    uint partition;
+    uint n_blockOffsetBits;
+    bool isPCStatsEnabled;
+
+    bool isInPartition(long long int addr)
+    {
+        return (((uint64_t) addr >> n_blockOffsetBits) & (n_set_groups - 1)) % n_partitions == partition;
+    }
+
+    bool isSetInPartition(uint set_num) {return (set_num & (n_set_groups - 1)) % n_partitions == partition;}
+
+    /*
+     * @brief Takes the sets of the partition of `shard` and adds its event counters (except the split counts)
+     */
+    void mergeSetPartition(CacheSimulator& shard);
+
+    // sendRequests of the CacheKernel of L1 (see selectRequestKernel)
+    typedef void (CacheSimulator::*RequestKernel)(const TraceEntry* entries, size_t n_entries);
+    RequestKernel request_kernel;
+
+    /*
+     * @brief Picks the sendRequests (and warmRequests) specialized on the L1 associativity and block size if
+     *        CACHE_KERNEL_GRID has it, the generic one otherwise (highly associative L1, uncommon geometries)
+     */
+    void selectRequestKernel();
+
+    template<typename L1Kernel>
+    void sendRequestsWith(const TraceEntry* entries, size_t n_entries);
+
+    // warmRequests of the CacheKernel of L1 (picked with request_kernel)
+    RequestKernel warm_kernel;
+
+    template<typename L1Kernel>
+    void warmRequestsWith(const TraceEntry* entries, size_t n_entries);
+
+    /*
+     * @brief sendRequest without statistics: the levels count nothing (see Cache::setWarming)
+     */
+    template<AccessType TYPE, typename L1Kernel>
+    void warmRequest(long long int addr);
+
+    uint prefetch_distance;
+    bool isL1Prefetched;    // set table of REQUEST_PREFETCH_MIN_BYTES or more
+    bool isL2Prefetched;    // same, and L2 runs on this thread
+
+    /*
+     * @brief Prefetches the L1 and L2 set metadata of `addr` (of the levels selected for prefetching)
+     */
+    template<typename L1Kernel>
+    void prefetchRequest(long long int addr)
+    {
+        if(isL1Prefetched) levels[0].prefetchSet<L1Kernel>(addr);
+        if(isL2Prefetched && !isLevelThreaded(1)) levels[1].prefetchSet(addr);
+    }
+
+    // L1 filter trace: requests to the next level are recorded, or replayed without an L1 (then not printed)
+    unique_ptr<FilterTraceWriter> filter_trace_writer;
+    bool isL1Replayed;
+
+    // Pipelined levels: every level below L1 runs on a thread of its own, level_pipelines[level] queues the requests
+    // of the level above for it (empty: all levels on this thread)
+    vector<unique_ptr<LevelPipeline>> level_pipelines;
+
+    bool isLevelThreaded(uint level) const {return level < level_pipelines.size() && level_pipelines[level];}
+
+    /*
+     * @brief Places the block of an L1 (+VC) miss in L1 and sends the demand and the evicted block to the next level
+     */
+    template<typename L1Kernel>
+    void allocateL1Block(long long int addr, uint64_t pc, const AccessResult& l1_result, bool isWrite);
+
+    /*
+     * @brief Everything a miss of the level above does in `level` and below: fetch of `addr`, then placement of the
+     *        block the level above evicted, if it sends one (NINE / inclusive: dirty victims only)
+     * @return true if the block comes up dirty (exclusive hierarchy: it was dirty in the level that gave it away)
+     */
+    bool fetchFromLevel(uint level, long long int addr, uint64_t pc, bool hasVictim, long long int victim_addr, bool isVictimDirty);
+
+    /*
+     * @brief Writeback of a dirty block of the level above into `level` (NINE, inclusive)
+     */
+    void writeBackToLevel(uint level, long long int addr);
 
-    // void sendRequests(vector<TraceEntry> trace_contents);
+    /*
+     * @brief fetchFromLevel / writeBackToLevel of a NINE level, queued for its thread if it has one
+     */
+    void forwardFetch(uint level, long long int addr, uint64_t pc, bool hasWriteback, long long int writeback_addr);
+    void forwardWriteback(uint level, long long int addr);
+
+    /*
+     * @brief A valid block `level` evicted (NINE / inclusive): back-invalidates it above when inclusive
+     * @return true if it has to be written back to the level below (dirty here or in a level above)
+     */
+    bool releaseBlock(uint level, long long int addr, bool isDirty);
 
+    /*
+     * @brief Exclusive hierarchy: places a victim of the level above in `level`, what it evicts moves further down
+     */
+    void insertVictim(uint level, long long int addr, bool isDirty);
     RawStatistics findRawStatistics();
     PerformanceStatistics findPerformanceStats();
     double findAAT();
     double findEDP();
     double findArea();
 public:
+    /*
+     * @param deeper_levels L3, L4, ... (only with an L2), with the block size of L1
+     */
     CacheSimulator(uint l1_size, uint l1_assoc, uint l1_blocksize,
                    uint n_vc_blocks,
-                   uint l2_size, uint l2_assoc, string trace_file_name);
+                   uint l2_size, uint l2_assoc, string trace_file_name,
+                   ReplacementPolicyKind policy_kind = ReplacementPolicyKind::LRU,
+                   InclusionPolicy inclusion = InclusionPolicy::NINE,
+                   const vector<LevelGeometry>& deeper_levels = vector<LevelGeometry>());
+
+    /*
+     * @brief Main memory latency plus block transfer time (the miss penalty of the AAT model)
+     */
+    static double findMissPenalty(uint blocksize);
 
     /*
      * @return Simulation statistics
      */
     SimulationStatistics getSimulationStats();
 
-    void sendReadRequest(long long int addr);
-    void sendWriteRequest(long long int addr);
+    /*
+     * @param pc program counter of the access (0 if unknown), passed on to the caches for per-PC statistics
+     * L1Kernel: CacheKernel of the L1 geometry, or the generic one
+     */
+    template<AccessType TYPE, typename L1Kernel = GenericCacheKernel>
+    void sendRequest(long long int addr, uint64_t pc = 0);
+
+    /*
+     * @brief Sends a batch of decoded trace accesses to the hierarchy, in trace order.
+     *
+     * An access whose size makes it straddle a block boundary is sent as one request per block it touches. While
+     * an access is simulated, the L1 / L2 set metadata of the access `prefetch distance` entries later is prefetched
+     * into the CPU caches; the simulation itself stays sequential, so results do not depend on the distance.
+     */
+    void sendRequests(const TraceEntry* entries, size_t n_entries);
+
+    /*
+     * @param distance accesses of a batch prefetched ahead (REQUEST_PREFETCH_DISTANCE by default, 0: none). Only
+     *        L1 / L2 set tables of REQUEST_PREFETCH_MIN_BYTES or more are prefetched, once the sets touched so far
+     *        take that much too.
+     */
+    void setPrefetchDistance(uint distance) {prefetch_distance = distance;}
+
+    /*
+     * @brief Functional warming: tags, dirty bits and replacement state evolve as with sendRequests, but no counter,
+     *        per-PC miss, filter trace record or prefetch is made (not with a level pipeline running)
+     */
+    void warmRequests(const TraceEntry* entries, size_t n_entries);
+
+    /*
+     * @brief Same results as sendRequests, with the set groups (see SetSampler) split over `n_threads` threads.
+     *
+     * Accesses of different set groups never touch the same L1 or L2 set, so every thread simulates the whole trace
+     * on a private copy of the hierarchy, skipping the accesses of the other threads' groups. The sets and counters
+     * of the copies are merged back at the end. A victim cache is shared by all L1 sets: with a VC, set sampling,
+     * a filter trace or level threads, the trace is simulated sequentially.
+     */
+    void sendRequestsSetPartitioned(const TraceEntry* entries, size_t n_entries, uint n_threads);
 
     // void printSimulationStats() { simulation_stats.printStats(); }
 
     void printCacheContents();
 
     void printSimulatorConfiguration();
+
+    /*
+     * @brief Arena of the sets of every level (mapped size, huge page backing)
+     */
+    const MetadataArena& getMetadataArena() const {return *arena;}
+
+    /*
+     * @brief Counts L1 / VC / L2 demand misses per PC (from traces that carry PCs)
+     */
+    void enablePCStatistics();
+
+    /*
+     * @brief Prints the `n_top` PCs with the most misses in every level
+     */
+    void printPCStatistics(uint n_top);
+
+    /*
+     * @brief Simulates only a random `fraction` of the sets (the same set groups at every level, see SetSampler).
+     *
+     * Accesses of the other sets are skipped; counts of RawStatistics are scaled up to the whole cache.
+     */
+    void enableSetSampling(double fraction);
+
+    /*
+     * @brief Prints the miss rates and AAT of a sampled simulation with their 95% confidence intervals
+     */
+    void printSetSamplingStatistics();
+
+    /*
+     * @brief Snapshot of the event counters (e.g. to measure one interval of the trace)
+     */
+    HierarchyCounters getCounters();
+
+    /*
+     * @brief Replaces the event counters, the statistics are then computed from them (cache contents are not touched)
+     */
+    void setCounters(const HierarchyCounters& counters);
+
+    /*
+     * @brief Records every request L1 sends to the next level into an L1 filter trace (filterTrace.h)
+     * @return false if the file cannot be created
+     */
+    bool recordFilterTrace(string filePath);
+
+    /*
+     * @brief Completes the filter trace with the L1 / VC counters
+     * @return false on I/O error
+     */
+    bool closeFilterTrace();
+
+    /*
+     * @brief Drives L2 from a filter trace recorded with this L1 / VC configuration, L1 is not simulated.
+     *
+     * L1 / VC statistics come from the recording run, so the statistics equal those of a full simulation.
+     */
+    void replayFilterTrace(FilterTraceReader& reader);
+
+    /*
+     * @brief Moves every level below L1 to a thread of its own: from now on L1 (+VC) queues its misses and writebacks
+     *        for L2, L2 its own for L3, and so on down the chain.
+     *
+     * Every level sees the request stream of the sequential simulation, so the statistics are identical. Until
+     * finishLevelThreads, only sendRequests / sendRequest may be called. No effect without an L2 or with inclusive or
+     * exclusive levels.
+     */
+    void startLevelThreads();
+
+    /*
+     * @brief Waits until every level below L1 has simulated its queued requests, stops their threads and prints the
+     *        stalls of every pipeline to stderr
+     */
+    void finishLevelThreads();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef CACTI_MEMO_H
+#define CACTI_MEMO_H
+
+#include<iostream>
+#include<vector>
+#include<string>
+#include<map>
+#include<tuple>
+#include<mutex>
+using namespace std;
+
+// On-disk memo table of CACTI results, in the working directory (next to ./cacti)
+#define CACTI_MEMO_PATH "cacti_memo.txt"
+
+// Technology node every CACTI run uses (see parse.h)
+#define CACTI_TECH_NODE "45nm"
+
+// Hit time (ns) of a geometry CACTI fails on
+#define CACTI_FALLBACK_HIT_TIME 0.2
+
+
+struct CactiResult
+{
+    float hitTime;
+    float energy;
+    float area;
+    bool isValid;       // false: CACTI failed, hitTime is CACTI_FALLBACK_HIT_TIME
+};
+
+
+/*
+ * @brief CACTI results of cache geometries, kept in CACTI_MEMO_PATH across runs.
+ *
+ * One line per geometry: `<size> <blocksize> <assoc|FA> <tech node> <access time> <energy> <area> <ok|failed>`.
+ * The table is loaded once per process (on the first lookup); geometries missing from it are run through CACTI
+ * (several threads may run CACTI at once) and appended to the file, failures included, so CACTI runs once per
+ * geometry ever. Later lines of the same geometry override earlier ones.
+ */
+class CactiMemo
+{
+private:
+    // (size, block size, associativity, 0 = FA) -> result, for CACTI_TECH_NODE
+    map<tuple<uint, uint, uint>, CactiResult> results;
+    mutex results_mutex;
+    string filePath;
+
+    CactiMemo(string filePath);
+    void load();
+    void append(const tuple<uint, uint, uint>& geometry, const CactiResult& result);
+
+    static tuple<uint, uint, uint> makeKey(uint cache_size, uint block_size, uint assoc);
+
+public:
+    /*
+     * @brief The memo table of the process, loaded from CACTI_MEMO_PATH on first use
+     */
+    static CactiMemo& getInstance();
+
+    /*
+     * @brief Memoized result of a geometry, CACTI is run (and its failure reported on stderr) if it is not known yet
+     */
+    CactiResult find(uint cache_size, uint block_size, uint assoc);
+
+    /*
+     * @brief Runs CACTI on `n_threads` threads for every geometry of `geometries` (size, block size, assoc) not memoized yet
+     * @return number of CACTI runs
+     */
+    size_t populate(const vector<tuple<uint, uint, uint>>& geometries, uint n_threads);
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef FILTER_TRACE_H
+#define FILTER_TRACE_H
+
+#include<iostream>
+#include<vector>
+#include<string>
+#include<cstdint>
+#include<cstdio>
+#include "cache.h"
+using namespace std;
+
+/*
+ * L1 filter trace format (little-endian): the requests an L1 (+VC) configuration sends to the next level.
+ *   header   FilterTraceHeader (168 bytes)
+ *   records  n_records x demand varint [+ writeback varint]
+ *
+ * Addresses are block addresses (addr >> log2(l1_blocksize)). The demand varint (up to 65 bits) is
+ * (zigzag(block - previous demand block) << 1 | has_writeback), the writeback varint is zigzag(writeback block - block).
+ * The header also keeps the L1 / VC counters of the recording run, so a replay can report the whole hierarchy.
+ */
+#define FILTER_TRACE_MAGIC "CSIMFTRC"
+#define FILTER_TRACE_VERSION 1
+#define FILTER_TRACE_COUNTERS 7     // n_reads, n_read_misses, n_writes, n_write_misses, n_swap_requests, n_swaps, n_writebacks
+
+struct FilterTraceHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t l1_size;
+    uint32_t l1_assoc;
+    uint32_t l1_blocksize;
+    uint32_t n_vc_blocks;
+    uint32_t reserved2;
+    uint64_t n_records;
+    uint64_t l1_counters[FILTER_TRACE_COUNTERS];
+    uint64_t vc_counters[FILTER_TRACE_COUNTERS];
+    uint64_t n_split_accesses;
+    uint64_t n_split_requests;
+};
+static_assert(sizeof(FilterTraceHeader) == 168, "filter trace header must be packed");
+
+
+/*
+ * @brief One request of L1 to the next level: a demand fetch (L1 read or write miss) and the dirty block it evicted
+ */
+struct FilterTraceRecord
+{
+    long long int addr;
+    uint64_t pc;                // PC of the demand access (not stored in filter traces: 0 when replayed)
+    bool hasWriteback;
+    long long int writeback_addr;
+};
+
+
+class FilterTraceWriter
+{
+private:
+    FILE* file;
+    FilterTraceHeader header;
+    uint n_blockOffsetBits;
+    uint64_t prev_block;
+    vector<unsigned char> buffer;
+
+    void writeVarint(uint64_t low, uint64_t high);
+    void flushBuffer();
+
+public:
+    FilterTraceWriter(string filePath, uint l1_size, uint l1_assoc, uint l1_blocksize, uint n_vc_blocks);
+    ~FilterTraceWriter();
+
+    bool isOpen() {return file != nullptr;}
+    void write(long long int addr, bool hasWriteback, long long int writeback_addr);
+
+    /*
+     * @brief Writes the record count and the L1 / VC counters into the header and closes the file
+     * @return false on I/O error
+     */
+    bool close(const CacheStatistics& l1_stats, const CacheStatistics& vc_stats, uint n_split_accesses, uint n_split_requests);
+};
+
+
+class FilterTraceReader
+{
+private:
+    FILE* file;
+    FilterTraceHeader header;
+    uint n_blockOffsetBits;
+    uint64_t prev_block;
+    uint64_t n_records_read;
+
+    bool readVarint(uint64_t& low, uint64_t& high);
+
+public:
+    /*
+     * @brief Opens a filter trace, exits on a malformed header
+     */
+    FilterTraceReader(string filePath);
+    ~FilterTraceReader();
+
+    bool isOpen() {return file != nullptr;}
+    const FilterTraceHeader& getHeader() {return header;}
+
+    /*
+     * @return false at the end of the trace (exits on a truncated record)
+     */
+    bool read(FilterTraceRecord& record);
+
+    /*
+     * @brief L1 / VC counters of the recording run
+     */
+    void getCounters(CacheStatistics& l1_stats, CacheStatistics& vc_stats);
+};
+
+#endif
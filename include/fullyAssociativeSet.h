@@ -0,0 +1,145 @@
+#ifndef FULLY_ASSOCIATIVE_SET_H
+#define FULLY_ASSOCIATIVE_SET_H
+
+#include<iostream>
+#include<vector>
+#include<cstdint>
+using namespace std;
+
+// Associativity from which Cache sets are indexed by a FullyAssociativeSet and LRU keeps a RecencyList (below it:
+// SIMD tag scan and LRU counters)
+#define FA_ENGINE_MIN_ASSOC 32
+
+
+/*
+ * @brief Slot of a FullyAssociativeSet: a tag and its way (-1: empty slot)
+ */
+struct FullyAssociativeSlot
+{
+    uint64_t tag = 0;
+    int way = -1;
+};
+
+
+/*
+ * @brief Tag index of one highly associative set (a fully associative cache is one such set).
+ *
+ * An open addressing hash table (linear probing, backward shift deletion) maps the tags of the valid ways to their
+ * way, so a lookup is O(1) instead of a scan of assoc ways. Block contents stay in the Cache arrays; the LRU order
+ * of such a set is a RecencyList. The table is a view of the slots of the set, kept by the cache in its set pages.
+ */
+class FullyAssociativeSet
+{
+private:
+    FullyAssociativeSlot* slots;
+    uint slot_mask;
+
+    uint findHomeSlot(uint64_t tag) const {return (uint)((tag * 0x9e3779b97f4a7c15ULL) >> 32) & slot_mask;}
+
+public:
+    /*
+     * @param n_slots slot count of the set (see findSlotCount)
+     */
+    FullyAssociativeSet(FullyAssociativeSlot* slots, uint n_slots) : slots(slots), slot_mask(n_slots - 1) {}
+
+    /*
+     * @return power of two with at least twice as many slots as ways: load factor at most 1/2
+     */
+    static uint findSlotCount(uint n_ways);
+
+    /*
+     * @return way of the valid block with `tag`, -1 if none
+     */
+    int find(uint64_t tag) const
+    {
+        for(uint slot = findHomeSlot(tag); slots[slot].way != -1; slot = (slot + 1) & slot_mask)
+        {
+            if(slots[slot].tag == tag) return slots[slot].way;
+        }
+        return -1;
+    }
+
+    /*
+     * @brief Indexes the valid block `tag` now held by `way` (the tag must not be indexed yet)
+     */
+    void insert(uint64_t tag, int way);
+
+    /*
+     * @brief Removes `tag` from the index (its way became invalid or holds another block)
+     */
+    void erase(uint64_t tag);
+};
+
+
+/*
+ * @brief Intrusive doubly linked list of the ways of a set from MRU to LRU: O(1) promotion and LRU way
+ *
+ * A view of a record of getRecordSize ints kept by the replacement policy (in its set pages): the head (MRU) and
+ * tail (LRU) ways, then the previous and the next way of every way.
+ */
+class RecencyList
+{
+private:
+    int& head;
+    int& tail;
+    int* prev_way;              // towards MRU, -1 at the head
+    int* next_way;              // towards LRU, -1 at the tail
+    uint n_ways;
+
+public:
+    /*
+     * @param record a record of a set of `n_ways` ways initialized by initRecord
+     */
+    RecencyList(int* record, uint n_ways)
+        : head(record[0]), tail(record[1]), prev_way(record + 2), next_way(record + 2 + n_ways), n_ways(n_ways) {}
+
+    static uint getRecordSize(uint n_ways) {return 2 + 2 * n_ways;}
+
+    /*
+     * @brief Ways start in order 0 (MRU) .. n_ways - 1 (LRU) like the LRU counters
+     */
+    static void initRecord(int* record, uint n_ways);
+
+    /*
+     * @brief Makes `way` the MRU way
+     */
+    void promote(int way)
+    {
+        if(way == head) return;
+
+        next_way[prev_way[way]] = next_way[way];
+        if(way == tail) tail = prev_way[way];
+        else prev_way[next_way[way]] = prev_way[way];
+
+        prev_way[way] = -1;
+        next_way[way] = head;
+        prev_way[head] = way;
+        head = way;
+    }
+
+    /*
+     * @brief Makes `way` the LRU way
+     */
+    void demote(int way)
+    {
+        if(way == tail) return;
+
+        prev_way[next_way[way]] = prev_way[way];
+        if(way == head) head = next_way[way];
+        else next_way[prev_way[way]] = next_way[way];
+
+        next_way[way] = -1;
+        prev_way[way] = tail;
+        next_way[tail] = way;
+        tail = way;
+    }
+
+    int getLRUWay() const {return tail;}
+
+    /*
+     * @return ways from MRU to LRU
+     */
+    vector<int> getRecencyOrder() const;
+};
+
+#endif
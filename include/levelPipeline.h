@@ -0,0 +1,79 @@
+#ifndef LEVEL_PIPELINE_H
+#define LEVEL_PIPELINE_H
+
+#include<iostream>
+#include<thread>
+#include<functional>
+#include "filterTrace.h"
+#include "ringBuffer.h"
+using namespace std;
+
+// Requests handed over at once, and batches in flight between two levels
+#define LEVEL_BATCH_SIZE 1024
+#define LEVEL_RING_BATCHES 64
+
+/*
+ * @brief Request of a level to the one below: a demand fetch and the dirty block it evicted (an L1 filter trace
+ *        record), or a writeback alone (the dirty victim of a writeback the level allocated)
+ */
+struct LevelRequest
+{
+    bool isWritebackOnly;       // true: the block of record.addr is written back, nothing is fetched
+    FilterTraceRecord record;
+};
+
+struct LevelRequestBatch
+{
+    size_t n_requests;      // 0 marks the end of the stream
+    LevelRequest requests[LEVEL_BATCH_SIZE];
+};
+
+
+/*
+ * @brief Runs a cache level on its own thread, fed with the requests of the level above through a lock-free ring.
+ *
+ * The level above pushes its misses / writebacks in order; a consumer thread drains them batch by batch in the same
+ * order, so the level below sees exactly the request stream of the sequential simulation.
+ */
+class LevelPipeline
+{
+private:
+    SPSCRingBuffer<LevelRequestBatch> ring;
+    LevelRequestBatch* batch;       // batch being filled by the producer, nullptr if none
+    function<void(const LevelRequest*, size_t)> consume;
+    thread consumer;
+
+    size_t n_producer_stalls;       // the ring was full (the level below is the bottleneck)
+    size_t n_consumer_stalls;       // the ring was empty (the level above is the bottleneck)
+
+    void drain();
+    void acquireBatch();
+    void publishBatch(size_t n_requests);
+
+public:
+    /*
+     * @param consume simulates a batch of requests in the level below (called on the consumer thread)
+     */
+    LevelPipeline(function<void(const LevelRequest*, size_t)> consume);
+    ~LevelPipeline();
+
+    /*
+     * @brief (level above) Queues one request, blocks while the ring is full
+     */
+    void push(const LevelRequest& request)
+    {
+        if(batch == nullptr) acquireBatch();
+        batch->requests[batch->n_requests++] = request;
+        if(batch->n_requests == LEVEL_BATCH_SIZE) publishBatch(LEVEL_BATCH_SIZE);
+    }
+
+    /*
+     * @brief Publishes the last requests and waits until the level below has simulated all of them
+     */
+    void finish();
+
+    size_t getProducerStalls() {return n_producer_stalls;}
+    size_t getConsumerStalls() {return n_consumer_stalls;}
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef METADATA_ARENA_H
+#define METADATA_ARENA_H
+
+#include<atomic>
+#include<cstddef>
+using namespace std;
+
+// Alignment and rounding of the arena region (x86-64 2 MB huge pages)
+#define ARENA_HUGE_PAGE_BYTES (2UL * 1024 * 1024)
+
+// Largest region mapped with MAP_HUGETLB: explicit huge pages are committed up front, so a larger region (a big
+// modeled cache of which a trace touches a few sets) would take its full capacity from the pool
+#define ARENA_HUGETLB_MAX_BYTES (64UL * 1024 * 1024)
+
+
+/*
+ * @brief One contiguous region holding the set pages of every cache level of a CacheSimulator (tags, state bits,
+ *        replacement state), so that the simulator's own metadata is covered by a few 2 MB TLB entries.
+ *
+ * Two phases: every SetPageTable reserves the bytes of all its pages when it is built, then the arena maps the
+ * sum once (map), and pages are carved out of it on first touch (allocate). Up to ARENA_HUGETLB_MAX_BYTES the region
+ * is mapped with MAP_HUGETLB if the huge page pool can hold it all. Else it is reserved, not committed, as normal
+ * memory advised to transparent huge pages, which the kernel backs only where pages are touched, so the memory of
+ * the simulator follows the footprint of the trace. allocate is thread-safe (L2 may run on a pipeline thread).
+ */
+class MetadataArena
+{
+private:
+    size_t n_reservedBytes;
+    size_t n_mappedBytes;
+    atomic<size_t> n_usedBytes;
+    char* base;
+    bool isHugeTLB;
+
+public:
+    MetadataArena();
+    ~MetadataArena();
+
+    // The arena owns its region: the tables point into it
+    MetadataArena(const MetadataArena&) = delete;
+    MetadataArena& operator=(const MetadataArena&) = delete;
+
+    /*
+     * @brief Adds the bytes a table may allocate, alignment padding included (before map)
+     */
+    void reserve(size_t n_bytes);
+
+    /*
+     * @brief Maps the reserved bytes, rounded up to huge pages (once, after every table reserved)
+     */
+    void map();
+
+    /*
+     * @return `n_bytes` of zeroed memory aligned to `alignment` (a power of two, at most a huge page)
+     */
+    void* allocate(size_t n_bytes, size_t alignment);
+
+    size_t getMappedBytes() const {return n_mappedBytes;}
+    size_t getUsedBytes() const {return n_usedBytes.load(memory_order_relaxed);}
+    bool isHugeTLBBacked() const {return isHugeTLB;}
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PROGRESS_REPORTER_H
+#define PROGRESS_REPORTER_H
+
+#include<iostream>
+#include<chrono>
+using namespace std;
+
+// Seconds between two progress lines
+#define PROGRESS_INTERVAL 5.0
+
+/*
+ * @brief Prints periodic progress of a long simulation (e.g. a live trace stream) to stderr
+ */
+class ProgressReporter
+{
+private:
+    chrono::steady_clock::time_point start_time;
+    chrono::steady_clock::time_point last_report_time;
+    size_t n_accesses;
+    size_t n_last_report_accesses;
+    bool isEnabled;
+
+    void report(chrono::steady_clock::time_point now);
+
+public:
+    ProgressReporter(bool isEnabled);
+
+    /*
+     * @brief Accounts `n_new_accesses` simulated accesses, prints a line once the interval has passed
+     */
+    void update(size_t n_new_accesses)
+    {
+        n_accesses += n_new_accesses;
+        if(isEnabled)
+        {
+            auto now = chrono::steady_clock::now();
+            if(chrono::duration<double>(now - last_report_time).count() >= PROGRESS_INTERVAL) report(now);
+        }
+    }
+
+    /*
+     * @brief Prints the final totals
+     */
+    void finish();
+};
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef REPLACEMENT_POLICY_H
+#define REPLACEMENT_POLICY_H
+
+#include<iostream>
+#include<vector>
+#include<string>
+#include<variant>
+#include<cstdint>
+#include "fullyAssociativeSet.h"
+#include "setPageTable.h"
+using namespace std;
+
+// Seed of the random policy (fixed, so runs are reproducible)
+#define REPLACEMENT_SEED 1
+
+// RRIP: 2-bit re-reference prediction values, BRRIP inserts at RRIP_MAX_RRPV - 1 once every BRRIP_LONG_PERIOD fills
+#define RRIP_MAX_RRPV 3
+#define BRRIP_LONG_PERIOD 32
+
+
+enum class ReplacementPolicyKind
+{
+    LRU,
+    TREE_PLRU,
+    SRRIP,
+    BRRIP,
+    FIFO,
+    RANDOM
+};
+
+/*
+ * @brief Maps a policy name (lru, plru, srrip, brrip, fifo, random) to its ReplacementPolicyKind
+ * @return false if the name is unknown
+ */
+bool parseReplacementPolicy(const string& name, ReplacementPolicyKind& kind);
+
+const char* getReplacementPolicyName(ReplacementPolicyKind kind);
+
+
+/*
+ * @return first invalid way of a set (valid bitmask as in Cache), -1 if all `assoc` ways are valid
+ */
+inline int findInvalidWay(const uint64_t* valid_bits, uint assoc)
+{
+    for(uint word = 0; word * 64 < assoc; word++)
+    {
+        uint64_t invalid = ~valid_bits[word];
+        if(invalid == 0) continue;
+        uint way = word * 64 + __builtin_ctzll(invalid);
+        return (way < assoc) ? (int) way : -1;
+    }
+    return -1;
+}
+
+
+/*
+ * Every policy keeps the replacement state of all sets of one cache and offers the same interface, which Cache
+ * calls through ReplacementPolicy (each call site is compiled for every policy):
+ *   onHit(set, way)            the block of `way` was accessed
+ *   onFill(set, way)           a new block was placed in `way`
+ *   onInvalidate(set, way)     the block of `way` was invalidated (back-invalidation, exclusive move to another level)
+ *   findVictim(set, valid)     way to replace (`valid` is the valid bitmask of the set)
+ *   prefetchSet(set)           hints the state of a set into the CPU caches ahead of an access (never allocates)
+ *   getOrder(set)              ways in the order the contents are printed (MRU first where the policy has one)
+ *   copySet(other, set)        takes the state of one set from a policy of the same geometry
+ *
+ * The state of a set is in a SetPageTable of the cache's MetadataArena: allocated and initialized when the set is
+ * first touched.
+ */
+
+
+/*
+ * @brief True LRU: counters (0 = MRU) for narrow sets, a linked list for sets of FA_ENGINE_MIN_ASSOC ways or more.
+ *
+ * Invalid ways are not preferred: they start as the LRU ways, as in the original counter scheme.
+ */
+class LRUPolicy
+{
+private:
+    uint assoc;
+    bool isListed;
+    SetPageTable<int> counters;
+    SetPageTable<int> lists;     // a RecencyList record per set
+
+    RecencyList getList(int set_num) {return RecencyList(lists.getSet(set_num), assoc);}
+
+public:
+    LRUPolicy() : assoc(0), isListed(false) {}
+    LRUPolicy(MetadataArena* arena, uint n_sets, uint assoc);
+
+    void onHit(int set_num, int way) {promote(set_num, way);}
+    void onFill(int set_num, int way) {promote(set_num, way);}
+
+    /*
+     * @brief An invalidated way becomes the LRU way, so it is filled next
+     */
+    void onInvalidate(int set_num, int way)
+    {
+        if(isListed)
+        {
+            getList(set_num).demote(way);
+            return;
+        }
+
+        int* set_counters = counters.getSet(set_num);
+        int cur_counter = set_counters[way];
+        for(uint i = 0; i < assoc; i++)
+        {
+            set_counters[i] -= (set_counters[i] > cur_counter);
+        }
+        set_counters[way] = assoc - 1;
+    }
+
+    /*
+     * N_WAYS: associativity known at compile time (counter loops unrolled, see CacheKernel), 0 if not
+     */
+    template<uint N_WAYS = 0>
+    void promote(int set_num, int way)
+    {
+        if(N_WAYS == 0 && isListed)
+        {
+            getList(set_num).promote(way);
+            return;
+        }
+
+        uint n_ways = (N_WAYS != 0) ? N_WAYS : assoc;
+        int* set_counters = counters.getSet(set_num);
+        int cur_counter = set_counters[way];
+        for(uint i = 0; i < n_ways; i++)
+        {
+            set_counters[i] += (set_counters[i] < cur_counter);
+        }
+        set_counters[way] = 0;
+    }
+
+    template<uint N_WAYS = 0>
+    int findVictim(int set_num, const uint64_t* /* valid_bits */)
+    {
+        if(N_WAYS == 0 && isListed) return getList(set_num).getLRUWay();
+
+        uint n_ways = (N_WAYS != 0) ? N_WAYS : assoc;
+        const int* set_counters = counters.getSet(set_num);
+        int max_way = 0;
+        for(uint i = 1; i < n_ways; i++)
+        {
+            if(set_counters[i] > set_counters[max_way]) max_way = i;
+        }
+        return max_way;
+    }
+
+    // A list is not prefetched: an access reads a few of its lines (head, neighbours of the way), not all of them
+    void prefetchSet(int set_num) const
+    {
+        if(!isListed) counters.prefetchSet(set_num);
+    }
+
+    vector<int> getOrder(int set_num);
+    void copySet(const LRUPolicy& other, int set_num);
+};
+
+
+/*
+ * @brief Tree pseudo-LRU: one bit per inner node of a binary tree over the ways points to the side to evict from.
+ *
+ * Non power of two associativities use the tree of the next power of two, never descending into missing ways.
+ */
+class TreePLRUPolicy
+{
+private:
+    uint assoc;
+    uint n_leaves;
+    uint n_words;       // per set, node k is bit k
+    SetPageTable<uint64_t> node_bits;
+
+    bool getNode(int set_num, uint node) {return (node_bits.getSet(set_num)[node / 64] >> (node % 64)) & 1;}
+    void setNode(int set_num, uint node, bool value)
+    {
+        uint64_t& word = node_bits.getSet(set_num)[node / 64];
+        word = (word & ~(1ULL << (node % 64))) | ((uint64_t) value << (node % 64));
+    }
+
+public:
+    TreePLRUPolicy(MetadataArena* arena, uint n_sets, uint assoc);
+
+    void onHit(int set_num, int way) {touch(set_num, way);}
+    void onFill(int set_num, int way) {touch(set_num, way);}
+    void onInvalidate(int /* set_num */, int /* way */) {}
+
+    /*
+     * @brief Points every node on the path to `way` away from it
+     */
+    void touch(int set_num, int way)
+    {
+        uint node = 1, low = 0, high = n_leaves;
+        while(high - low > 1)
+        {
+            uint mid = (low + high) / 2;
+            bool isLeft = (uint) way < mid;
+            setNode(set_num, node, isLeft);     // 1: evict from the right half
+            node = 2 * node + (isLeft ? 0 : 1);
+            if(isLeft) high = mid;
+            else low = mid;
+        }
+    }
+
+    int findVictim(int set_num, const uint64_t* valid_bits)
+    {
+        int invalid_way = findInvalidWay(valid_bits, assoc);
+        if(invalid_way != -1) return invalid_way;
+
+        uint node = 1, low = 0, high = n_leaves;
+        while(high - low > 1)
+        {
+            uint mid = (low + high) / 2;
+            bool isRight = getNode(set_num, node) && mid < assoc;
+            node = 2 * node + (isRight ? 1 : 0);
+            if(isRight) low = mid;
+            else high = mid;
+        }
+        return low;
+    }
+
+    void prefetchSet(int set_num) const {node_bits.prefetchSet(set_num);}
+
+    vector<int> getOrder(int set_num);
+    void copySet(const TreePLRUPolicy& other, int set_num);
+};
+
+
+/*
+ * @brief Static (SRRIP) or bimodal (BRRIP) re-reference interval prediction with 2-bit RRPVs.
+ *
+ * Hits predict a near re-reference (RRPV 0). SRRIP fills at RRIP_MAX_RRPV - 1; BRRIP fills at RRIP_MAX_RRPV except
+ * once every BRRIP_LONG_PERIOD fills of a set. The victim is the first way at RRIP_MAX_RRPV, after aging the set.
+ */
+class RRIPPolicy
+{
+private:
+    uint assoc;
+    bool isBimodal;
+    SetPageTable<uint8_t> rrpvs;
+    SetPageTable<uint8_t> fill_counts;  // BRRIP fills of every set, modulo BRRIP_LONG_PERIOD
+
+public:
+    RRIPPolicy(MetadataArena* arena, uint n_sets, uint assoc, bool isBimodal);
+
+    void onHit(int set_num, int way) {rrpvs.getSet(set_num)[way] = 0;}
+
+    void onFill(int set_num, int way)
+    {
+        uint8_t rrpv = RRIP_MAX_RRPV - 1;
+        if(isBimodal)
+        {
+            uint8_t& fill_count = *fill_counts.getSet(set_num);
+            if(fill_count != 0) rrpv = RRIP_MAX_RRPV;
+            fill_count = (fill_count + 1) % BRRIP_LONG_PERIOD;
+        }
+        rrpvs.getSet(set_num)[way] = rrpv;
+    }
+
+    void onInvalidate(int set_num, int way) {rrpvs.getSet(set_num)[way] = RRIP_MAX_RRPV;}
+
+    int findVictim(int set_num, const uint64_t* valid_bits)
+    {
+        int invalid_way = findInvalidWay(valid_bits, assoc);
+        if(invalid_way != -1) return invalid_way;
+
+        uint8_t* set_rrpvs = rrpvs.getSet(set_num);
+        uint8_t max_rrpv = 0;
+        for(uint i = 0; i < assoc; i++) max_rrpv = max(max_rrpv, set_rrpvs[i]);
+
+        // Aging until a way reaches RRIP_MAX_RRPV, in one step
+        uint8_t aging = RRIP_MAX_RRPV - max_rrpv;
+        int victim = -1;
+        for(uint i = 0; i < assoc; i++)
+        {
+            set_rrpvs[i] += aging;
+            if(victim == -1 && set_rrpvs[i] == RRIP_MAX_RRPV) victim = i;
+        }
+        return victim;
+    }
+
+    void prefetchSet(int set_num) const
+    {
+        rrpvs.prefetchSet(set_num);
+        if(isBimodal) fill_counts.prefetchSet(set_num);
+    }
+
+    vector<int> getOrder(int set_num);
+    void copySet(const RRIPPolicy& other, int set_num);
+};
+
+
+/*
+ * @brief First in, first out: a round-robin fill pointer per set (invalid ways are filled first)
+ */
+class FIFOPolicy
+{
+private:
+    uint assoc;
+    SetPageTable<uint> next_victims;
+
+public:
+    FIFOPolicy(MetadataArena* arena, uint n_sets, uint assoc);
+
+    void onHit(int /* set_num */, int /* way */) {}
+
+    void onFill(int set_num, int way)
+    {
+        uint& next_victim = *next_victims.getSet(set_num);
+        if((uint) way == next_victim) next_victim = (next_victim + 1 == assoc) ? 0 : next_victim + 1;
+    }
+
+    void onInvalidate(int /* set_num */, int /* way */) {}
+
+    int findVictim(int set_num, const uint64_t* valid_bits)
+    {
+        int invalid_way = findInvalidWay(valid_bits, assoc);
+        return (invalid_way != -1) ? invalid_way : (int) *next_victims.getSet(set_num);
+    }
+
+    void prefetchSet(int set_num) const {next_victims.prefetchSet(set_num);}
+
+    vector<int> getOrder(int set_num);
+    void copySet(const FIFOPolicy& other, int set_num);
+};
+
+
+/*
+ * @brief Random replacement (invalid ways first): one xorshift generator per set, seeded from REPLACEMENT_SEED and
+ *        the set number, so results do not depend on the order sets are simulated in
+ */
+class RandomPolicy
+{
+private:
+    uint assoc;
+    SetPageTable<uint64_t> states;
+
+public:
+    RandomPolicy(MetadataArena* arena, uint n_sets, uint assoc);
+
+    void onHit(int /* set_num */, int /* way */) {}
+    void onFill(int /* set_num */, int /* way */) {}
+    void onInvalidate(int /* set_num */, int /* way */) {}
+
+    int findVictim(int set_num, const uint64_t* valid_bits)
+    {
+        int invalid_way = findInvalidWay(valid_bits, assoc);
+        if(invalid_way != -1) return invalid_way;
+
+        uint64_t& state = *states.getSet(set_num);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state % assoc;
+    }
+
+    void prefetchSet(int set_num) const {states.prefetchSet(set_num);}
+
+    vector<int> getOrder(int set_num);
+    void copySet(const RandomPolicy& other, int set_num);
+};
+
+
+typedef variant<LRUPolicy, TreePLRUPolicy, RRIPPolicy, FIFOPolicy, RandomPolicy> ReplacementPolicy;
+
+ReplacementPolicy makeReplacementPolicy(MetadataArena* arena, ReplacementPolicyKind kind, uint n_sets, uint assoc);
+
+#endif
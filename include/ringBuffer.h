@@ -0,0 +1,67 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include<atomic>
+#include<vector>
+#include<cstddef>
+using namespace std;
+
+/*
+ * @brief Bounded single-producer / single-consumer lock-free ring of slots.
+ *
+ * Slots are filled and drained in place: the producer acquires a free slot, fills it and publishes it;
+ * the consumer acquires the oldest published slot, uses it and releases it.
+ * Capacity must be a power of two.
+ */
+template<typename T>
+class SPSCRingBuffer
+{
+private:
+    vector<T> slots;
+    size_t mask;
+
+    // Producer and consumer positions live on separate cache lines
+    alignas(64) atomic<size_t> head;    // next slot to read
+    alignas(64) atomic<size_t> tail;    // next slot to write
+
+public:
+    SPSCRingBuffer(size_t capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+    /*
+     * @brief (producer) Free slot to fill, nullptr if the ring is full
+     */
+    T* tryAcquireWrite()
+    {
+        size_t cur_tail = tail.load(memory_order_relaxed);
+        if(cur_tail - head.load(memory_order_acquire) == slots.size()) return nullptr;
+        return &slots[cur_tail & mask];
+    }
+
+    /*
+     * @brief (producer) Makes the slot returned by tryAcquireWrite visible to the consumer
+     */
+    void publishWrite()
+    {
+        tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    /*
+     * @brief (consumer) Oldest published slot, nullptr if the ring is empty
+     */
+    T* tryAcquireRead()
+    {
+        size_t cur_head = head.load(memory_order_relaxed);
+        if(cur_head == tail.load(memory_order_acquire)) return nullptr;
+        return &slots[cur_head & mask];
+    }
+
+    /*
+     * @brief (consumer) Hands the slot returned by tryAcquireRead back to the producer
+     */
+    void releaseRead()
+    {
+        head.store(head.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef SET_PAGE_TABLE_H
+#define SET_PAGE_TABLE_H
+
+#include<vector>
+#include<functional>
+#include<algorithm>
+#include<new>
+#include<type_traits>
+#include<cstdint>
+#include "metadataArena.h"
+using namespace std;
+
+// Bytes of set state a page of a SetPageTable holds (a page has at least one set)
+#define SET_PAGE_BYTES 4096
+
+// Cache line size of the host (alignment of SIMD-loaded sets, step of SetPageTable::prefetchSet)
+#define CACHE_LINE_SIZE 64
+
+
+/*
+ * @brief Per-set state of a cache in a two-level page table: a directory of pages of 2^page_shift sets, each page
+ *        allocated from the MetadataArena and initialized on the first touch of one of its sets.
+ *
+ * Every set has `set_stride` elements of T. Untouched pages take no memory, so the memory of a cache follows the
+ * sets a trace touches rather than its modeled capacity. Pages are aligned to Alignment and set offsets within a
+ * page are multiples of the set size (sets of an aligned size stay aligned). Tables are move-only: the pages are
+ * owned by the table (elements destroyed with it) and stored in the arena, which outlives it.
+ */
+template<typename T, size_t Alignment = alignof(T)>
+class SetPageTable
+{
+private:
+    MetadataArena* arena;
+    uint set_stride;
+    uint page_shift;
+    uint set_mask;                          // set number -> set within its page
+    vector<T*> directory;                   // first element of every page, nullptr: not touched yet
+    function<void(uint, T*)> init_set;      // initial state of a set (set number, its elements), T() if none
+
+    size_t getPageElements() const {return (size_t) set_stride << page_shift;}
+
+    // Out of line and cold, so that getSet stays small enough to be inlined on the access path
+    __attribute__((noinline, cold)) T* allocatePage(uint page_num)
+    {
+        T* page = static_cast<T*>(arena->allocate(getPageElements() * sizeof(T), Alignment));
+        for(size_t i = 0; i < getPageElements(); i++) new (page + i) T();
+        if(init_set)
+        {
+            for(uint i = 0; i <= set_mask; i++) init_set((page_num << page_shift) + i, page + (size_t) i * set_stride);
+        }
+        directory[page_num] = page;
+        return page;
+    }
+
+    void destroyPages()
+    {
+        if constexpr(!is_trivially_destructible_v<T>)
+        {
+            for(T* page : directory)
+            {
+                if(page == nullptr) continue;
+                for(size_t i = 0; i < getPageElements(); i++) page[i].~T();
+            }
+        }
+        directory.clear();
+    }
+
+public:
+    SetPageTable() : arena(nullptr), set_stride(0), page_shift(0), set_mask(0) {}
+
+    /*
+     * @brief Reserves the pages of all `n_sets` sets in `arena` (allocated on first touch, see MetadataArena)
+     */
+    SetPageTable(MetadataArena* arena, uint n_sets, uint set_stride, function<void(uint, T*)> init_set = nullptr)
+    {
+        this->arena = arena;
+        this->set_stride = set_stride;
+        this->init_set = init_set;
+
+        page_shift = 0;
+        while((2ULL << page_shift) <= n_sets && ((size_t) set_stride * sizeof(T) << (page_shift + 1)) <= SET_PAGE_BYTES)
+        {
+            page_shift++;
+        }
+        set_mask = (1u << page_shift) - 1;
+        directory.assign((n_sets + set_mask) >> page_shift, nullptr);
+
+        // Every page may need up to Alignment - 1 bytes of padding before it
+        arena->reserve(directory.size() * (getPageElements() * sizeof(T) + Alignment - 1));
+    }
+
+    ~SetPageTable() {destroyPages();}
+
+    SetPageTable(const SetPageTable&) = delete;
+    SetPageTable& operator=(const SetPageTable&) = delete;
+
+    SetPageTable(SetPageTable&& other)
+        : arena(other.arena), set_stride(other.set_stride), page_shift(other.page_shift), set_mask(other.set_mask),
+          directory(move(other.directory)), init_set(move(other.init_set))
+    {
+        other.directory.clear();
+    }
+
+    SetPageTable& operator=(SetPageTable&& other)
+    {
+        if(this == &other) return *this;
+        destroyPages();
+        arena = other.arena;
+        set_stride = other.set_stride;
+        page_shift = other.page_shift;
+        set_mask = other.set_mask;
+        directory = move(other.directory);
+        init_set = move(other.init_set);
+        other.directory.clear();
+        return *this;
+    }
+
+    /*
+     * @brief Elements of a set, its page is allocated if untouched
+     */
+    T* getSet(uint set_num)
+    {
+        T* page = directory[set_num >> page_shift];
+        if(__builtin_expect(page == nullptr, 0)) page = allocatePage(set_num >> page_shift);
+        return page + (size_t)(set_num & set_mask) * set_stride;
+    }
+
+    /*
+     * @return elements of a set, nullptr if its page was never touched
+     */
+    const T* findSet(uint set_num) const
+    {
+        const T* page = directory[set_num >> page_shift];
+        if(page == nullptr) return nullptr;
+        return page + (size_t)(set_num & set_mask) * set_stride;
+    }
+
+    bool isTouched(uint set_num) const {return findSet(set_num) != nullptr;}
+
+    /*
+     * @return bytes of all the pages, allocated or not
+     */
+    size_t getCapacityBytes() const {return directory.size() * getPageElements() * sizeof(T);}
+
+    /*
+     * @brief Hints the cache lines of a set into the CPU caches before it is accessed (untouched sets are skipped,
+     *        a prefetch never allocates a page)
+     */
+    void prefetchSet(uint set_num) const
+    {
+        const T* set = findSet(set_num);
+        if(set == nullptr) return;
+
+        uintptr_t first_line = (uintptr_t) set & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+        uintptr_t end = (uintptr_t)(set + set_stride);
+        for(uintptr_t line = first_line; line < end; line += CACHE_LINE_SIZE) __builtin_prefetch((const void*) line, 1);
+
+        // GCC counts prefetches as free of side effects: without this, a call that is not inlined is deemed pure
+        // and deleted
+        asm volatile("");
+    }
+
+    /*
+     * @brief Takes one set from a table of the same geometry (an untouched set stays untouched or is reinitialized)
+     */
+    void copySet(const SetPageTable& other, uint set_num)
+    {
+        const T* other_set = other.findSet(set_num);
+        if(other_set == nullptr && !isTouched(set_num)) return;
+
+        T* set = getSet(set_num);
+        if(other_set != nullptr)
+            copy_n(other_set, set_stride, set);
+        else if(init_set)
+            init_set(set_num, set);
+        else
+            fill_n(set, set_stride, T());
+    }
+};
+
+#endif
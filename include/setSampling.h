@@ -0,0 +1,102 @@
+#ifndef SET_SAMPLING_H
+#define SET_SAMPLING_H
+
+#include<iostream>
+#include<vector>
+#include<cstdint>
+using namespace std;
+
+// Seed of the set group selection (fixed, so sampled runs are reproducible)
+#define SET_SAMPLING_SEED 1
+
+// Two-sided 95% normal quantile of the confidence intervals
+#define SET_SAMPLING_Z 1.96
+
+
+/*
+ * @brief Counters of the accesses mapped to one set group
+ */
+struct SetGroupCounters
+{
+    uint64_t n_accesses = 0;
+    uint64_t n_misses = 0;              // combined L1+VC misses (= L2 reads when there is an L2)
+    uint64_t n_swap_requests = 0;
+    uint64_t n_l2_read_misses = 0;
+};
+
+
+/*
+ * @brief Estimate of a ratio over all set groups and the half width of its confidence interval
+ */
+struct SampledEstimate
+{
+    double value;
+    double half_width;
+};
+
+
+/*
+ * @brief Chooses the sets a sampled simulation keeps and estimates whole-cache ratios from them.
+ *
+ * A set group is the block addresses with the same low `log2(n_groups)` index bits, with n_groups the smallest set
+ * count of the hierarchy: a group covers whole sets of every level, so the L1 and L2 sets of a sampled block are
+ * all sampled and L1 evictions / writebacks stay inside the sample. Groups are picked at random (fixed seed).
+ * Miss rates are ratio estimators over the sampled groups (cluster sampling), their variance comes from the
+ * spread of the per-group ratios.
+ */
+class SetSampler
+{
+private:
+    uint n_groups;
+    uint n_blockOffsetBits;
+    vector<bool> isGroupSampled;
+    vector<uint> sampled_groups;
+    vector<SetGroupCounters> group_counters;
+    SetGroupCounters last_totals;       // totals of the hierarchy after the previous sampled access
+
+    /*
+     * @param value numerator of a group, `weight` its denominator
+     */
+    template<typename Numerator, typename Denominator>
+    SampledEstimate estimateRatio(Numerator value, Denominator weight);
+
+public:
+    SetSampler() : n_groups(0), n_blockOffsetBits(0) {}
+
+    /*
+     * @param n_groups smallest set count of the hierarchy (a power of two)
+     * @param fraction share of the groups simulated, in (0, 1]
+     */
+    SetSampler(uint n_groups, uint block_size, double fraction);
+
+    bool isSampled(long long int addr)
+    {
+        return isGroupSampled[((uint64_t) addr >> n_blockOffsetBits) & (n_groups - 1)];
+    }
+
+    /*
+     * @brief Charges the growth of the hierarchy totals since the previous sampled access to the group of `addr`
+     */
+    void recordAccess(long long int addr, const SetGroupCounters& totals);
+
+    uint getGroupCount() {return n_groups;}
+    uint getSampledGroupCount() {return sampled_groups.size();}
+
+    /*
+     * @brief Factor that scales counts of the sampled sets up to the whole cache
+     */
+    double getScale() {return (double) n_groups / sampled_groups.size();}
+
+    SampledEstimate estimateMissRate();
+    SampledEstimate estimateL2MissRate();
+
+    /*
+     * @brief AAT of CacheSimulator written as one ratio:
+     *        l1_hit_time + (swap requests x vc_hit_time + L1+VC misses x l1_miss_time + L2 read misses x l2_miss_time) / accesses
+     * @param l1_miss_time L2 hit time, or the miss penalty without an L2
+     * @param l2_miss_time miss penalty, or 0 without an L2
+     */
+    SampledEstimate estimateAAT(double l1_hit_time, double vc_hit_time, double l1_miss_time, double l2_miss_time);
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include<iostream>
+#include<vector>
+#include<set>
+#include<cstdint>
+#include "trace.h"
+#include "stackDistance.h"
+using namespace std;
+
+// Sampling hashes are reduced to this many bits: block sampled iff hash < threshold (rate = threshold / 2^bits)
+#define SHARDS_HASH_BITS 24
+
+// Independent samplers (different hash salts) sharing the memory budget, their spread gives the error estimate
+#define SHARDS_REPLICAS 4
+
+// Approximate memory one sampled block costs (stack position map, hash-ordered set, Fenwick positions)
+#define SHARDS_BYTES_PER_BLOCK 128
+
+
+/*
+ * @brief Fixed-size SHARDS sampler: LRU stack distances of the blocks whose hash falls under an adaptive threshold.
+ *
+ * Once more than `max_blocks` blocks are sampled, the threshold drops to the largest sampled hash and the blocks at
+ * or above it are evicted, so memory stays bounded. Counts gathered at a higher rate are rescaled to the new rate.
+ * A sampled distance d stands for d / rate blocks of the full trace.
+ */
+class ShardsSampler
+{
+private:
+    uint64_t salt;
+    uint32_t threshold;
+    size_t max_blocks;
+    LRUStackDistance stack;
+    set<pair<uint32_t, uint64_t>> sampled_blocks;   // (hash, block), largest hash evicted first
+
+    vector<uint64_t> capacities;    // ascending, in blocks
+    vector<double> bucket_hits;     // [k]: sampled reuses with scaled distance in [capacities[k-1], capacities[k])
+    double n_sampled;               // sampled accesses, rescaled to the current rate
+
+    uint32_t hashBlock(uint64_t block);
+    void lowerThreshold();
+
+public:
+    ShardsSampler(uint64_t salt, size_t max_blocks, const vector<uint64_t>& capacities);
+
+    void accessBlock(uint64_t block);
+
+    double getSamplingRate() {return (double) threshold / (1 << SHARDS_HASH_BITS);}
+    size_t getSampledBlockCount() {return sampled_blocks.size();}
+
+    /*
+     * @brief Estimated miss ratio of a fully associative LRU cache of capacities[k] blocks (SHARDS_adj corrected)
+     * @param n_accesses block accesses of the whole trace
+     */
+    double getMissRatio(size_t k, uint64_t n_accesses);
+};
+
+
+/*
+ * @brief Approximate LRU miss ratio curve in bounded memory (SHARDS spatial sampling)
+ */
+class ShardsProfiler
+{
+private:
+    uint n_blockOffsetBits;
+    uint64_t n_accesses;
+    vector<ShardsSampler> samplers;
+
+public:
+    /*
+     * @param capacities cache sizes in blocks, ascending
+     * @param memory_budget bytes shared by all samplers
+     */
+    ShardsProfiler(uint block_size, const vector<uint64_t>& capacities, size_t memory_budget);
+
+    /*
+     * @brief Profiles decoded trace accesses (block-crossing accesses touch every block, as in CacheSimulator)
+     */
+    void sendRequests(const TraceEntry* entries, size_t n_entries);
+
+    /*
+     * @brief Mean miss ratio of the samplers for capacities[k] and its standard error
+     */
+    void getMissRatio(size_t k, double& miss_ratio, double& std_error);
+
+    uint64_t getAccessCount() {return n_accesses;}
+    double getSamplingRate() {return samplers[0].getSamplingRate();}
+    size_t getSampledBlockCount() {return samplers[0].getSampledBlockCount();}
+};
+
+#endif
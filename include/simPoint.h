@@ -0,0 +1,69 @@
+#ifndef SIM_POINT_H
+#define SIM_POINT_H
+
+#include<iostream>
+#include<vector>
+#include<cstdint>
+#include "cacheSimulator.h"
+#include "trace.h"
+using namespace std;
+
+// Dimensions of an interval signature ((block address, operation) pairs are hashed onto them, like SimPoint's random projection)
+#define SIMPOINT_DIMENSIONS 64
+
+// k-means: seed of the initial centroids and iteration limit
+#define SIMPOINT_SEED 1
+#define SIMPOINT_MAX_ITERATIONS 100
+
+
+/*
+ * @brief SimPoint-style interval sampling: simulates in detail only one representative interval per program phase.
+ *
+ * 1. profile(): the trace is cut into intervals of `interval_length` accesses, each summarized by the normalized
+ *    histogram of its block addresses hashed onto SIMPOINT_DIMENSIONS buckets.
+ * 2. findSimulationPoints(): k-means groups the signatures, the interval closest to each centroid represents its
+ *    cluster with weight = cluster size / number of intervals.
+ * 3. simulate(): the trace is replayed; representative intervals are measured, the others only warm the caches
+ *    (CacheSimulator::warmRequests). The weighted interval counts are installed as the counters of the simulator,
+ *    so its usual SimulationStatistics describe the whole trace.
+ */
+class SimPointSampler
+{
+private:
+    uint64_t interval_length;
+    uint n_clusters;
+    uint n_blockOffsetBits;
+
+    vector<vector<double>> signatures;      // one per interval
+    vector<uint64_t> interval_accesses;     // accesses of every interval (the last one may be short)
+    vector<uint> cluster_of;                // interval -> cluster
+    vector<uint64_t> representatives;       // simulation point (interval) of every non-empty cluster
+    vector<double> weights;                 // share of the trace accesses its cluster holds
+
+    void addSignature(const vector<double>& block_counts, uint64_t n_accesses);
+    double findDistance(const vector<double>& a, const vector<double>& b);
+
+public:
+    SimPointSampler(uint64_t interval_length, uint n_clusters, uint block_size);
+
+    /*
+     * @brief First pass: builds the signature of every interval
+     */
+    void profile(Trace& trace);
+
+    /*
+     * @brief Clusters the signatures and picks the simulation points
+     */
+    void findSimulationPoints();
+
+    /*
+     * @brief Second pass (on a fresh Trace of the same file): warms and measures, then sets the weighted counters
+     */
+    void simulate(Trace& trace, CacheSimulator& cache_sim);
+
+    void printSimulationPoints();
+
+    size_t getIntervalCount() {return signatures.size();}
+};
+
+#endif
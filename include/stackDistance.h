@@ -0,0 +1,143 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include<iostream>
+#include<vector>
+#include<unordered_map>
+#include<cstdint>
+#include "trace.h"
+using namespace std;
+
+// Default initial number of positions of an LRUStackDistance Fenwick tree
+#define MIN_STACK_POSITIONS (1 << 20)
+
+/*
+ * @brief Fenwick (binary indexed) tree of counts over positions [0, size)
+ */
+class FenwickTree
+{
+private:
+    vector<int32_t> tree;
+
+public:
+    void reset(size_t size) {tree.assign(size + 1, 0);}
+    size_t size() {return tree.size() - 1;}
+
+    void add(size_t pos, int32_t delta)
+    {
+        for(pos++; pos < tree.size(); pos += pos & (0 - pos)) tree[pos] += delta;
+    }
+
+    /*
+     * @return sum of the counts in [0, end)
+     */
+    int64_t prefixSum(size_t end)
+    {
+        int64_t sum = 0;
+        for(; end > 0; end -= end & (0 - end)) sum += tree[end];
+        return sum;
+    }
+};
+
+
+/*
+ * @brief LRU stack distances of a stream of blocks (fully associative Mattson stack).
+ *
+ * The latest access position of every block is marked in a Fenwick tree: the distance of an access is the number
+ * of marks after the block's previous position. Positions are renumbered once the tree is full, so memory stays
+ * proportional to the number of distinct blocks, not to the trace length.
+ */
+class LRUStackDistance
+{
+private:
+    FenwickTree live_positions;                         // 1 at the latest access position of every block
+    unordered_map<uint64_t, uint64_t> last_position;    // block -> position of its latest access
+    uint64_t next_position;
+    size_t min_positions;
+
+    /*
+     * @brief Renumbers the live positions 0..n_blocks-1 (in access order)
+     */
+    void compactPositions();
+
+public:
+    /*
+     * @param min_positions smallest Fenwick tree kept (it grows to twice the number of distinct blocks)
+     */
+    LRUStackDistance(size_t min_positions = MIN_STACK_POSITIONS);
+
+    /*
+     * @brief Moves `block` to the top of the stack
+     * @param distance number of other blocks used since the previous access of `block`
+     * @return false on the first access of `block` (infinite distance)
+     */
+    bool access(uint64_t block, uint64_t& distance);
+
+    /*
+     * @brief Drops `block` from the stack (it no longer counts in the distances of other blocks)
+     */
+    void remove(uint64_t block);
+
+    size_t getBlockCount() {return last_position.size();}
+};
+
+
+/*
+ * @brief One-pass LRU stack-distance (Mattson) profiler: exact LRU miss ratios of many caches of one block size.
+ *
+ * LRU is a stack algorithm (with write-allocate, reads and writes alike), so an access hits in every cache
+ * whose capacity exceeds its stack distance.
+ *   - Fully associative: one LRUStackDistance over the whole trace gives the miss ratio of every FA size at once.
+ *   - Set associative: for every set count a per-set LRU stack of depth `max_assoc` is kept (Hill's
+ *     all-associativity simulation), the depth of a hit gives the miss ratio of every associativity at once.
+ */
+class StackDistanceProfiler
+{
+private:
+    uint block_size;
+    uint n_blockOffsetBits;
+    uint max_assoc;
+    uint64_t n_accesses;
+
+    // Fully associative
+    LRUStackDistance fa_stack;
+    uint64_t n_cold_misses;
+    vector<uint64_t> distance_histogram;                // [d]: accesses with d other blocks used since the previous one
+
+    // Set associative, one per set count
+    struct SetStacks
+    {
+        uint n_sets;
+        vector<uint64_t> stacks;        // n_sets x max_assoc, MRU first, block + 1 (0 = empty)
+        vector<uint64_t> depth_hits;    // [d]: hits at stack depth d
+    };
+    vector<SetStacks> set_stacks;
+
+    void accessBlock(uint64_t block);
+
+public:
+    /*
+     * @param set_counts set counts (powers of two) to profile set-associative caches for
+     * @param max_assoc largest associativity asked for at those set counts
+     */
+    StackDistanceProfiler(uint block_size, const vector<uint>& set_counts, uint max_assoc);
+
+    /*
+     * @brief Profiles decoded trace accesses (block-crossing accesses touch every block, as in CacheSimulator)
+     */
+    void sendRequests(const TraceEntry* entries, size_t n_entries);
+
+    uint64_t getAccessCount() {return n_accesses;}
+
+    /*
+     * @brief Miss ratio of a fully associative LRU cache of `n_blocks` blocks
+     */
+    double getFAMissRatio(uint64_t n_blocks);
+
+    /*
+     * @brief Miss ratio of an LRU cache with `n_sets` sets (one of the profiled set counts) and `assoc` <= max_assoc ways
+     */
+    double getMissRatio(uint n_sets, uint assoc);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include<iostream>
+#include<vector>
+#include<string>
+#include "cacheSimulator.h"
+#include "trace.h"
+using namespace std;
+
+/*
+ * @brief One point of a sweep: the six cache_sim configuration arguments
+ */
+struct SweepConfig
+{
+    uint l1_size;
+    uint l1_assoc;
+    uint l1_blocksize;
+    uint n_vc_blocks;
+    uint l2_size;
+    uint l2_assoc;
+};
+
+
+/*
+ * @brief Simulates many configurations on one trace inside a single process.
+ *
+ * The trace is decoded once and shared read-only; every configuration gets its own CacheSimulator,
+ * run as a task of a work-stealing thread pool. Results come out in config file order.
+ */
+class SweepEngine
+{
+private:
+    vector<SweepConfig> configs;
+    vector<SimulationStatistics> results;
+
+public:
+    /*
+     * @brief Reads the config matrix, one configuration per line:
+     *        `<L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC>`
+     *
+     * Blank lines and `#` comments are skipped. Exits with the line number of a malformed line.
+     * @return false if the file cannot be opened
+     */
+    bool readConfigs(string configFilePath);
+
+    /*
+     * @brief Simulates every configuration on `trace_contents` with `n_threads` threads
+     * @param sample_fraction share of the sets simulated (set sampling) if below 1
+     */
+    void run(const vector<TraceEntry>& trace_contents, string trace_file_name, uint n_threads, double sample_fraction = 1,
+             ReplacementPolicyKind policy_kind = ReplacementPolicyKind::LRU, InclusionPolicy inclusion = InclusionPolicy::NINE);
+
+    /*
+     * @brief Prints a CSV header and one row per configuration
+     */
+    void printResults();
+
+    size_t getConfigCount() {return configs.size();}
+    const vector<SweepConfig>& getConfigs() {return configs;}
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef TAG_MATCH_H
+#define TAG_MATCH_H
+
+#include<cstdint>
+#include<cstdlib>
+using namespace std;
+
+// Ways whose tags one SIMD compare covers (AVX2: 4 x 64 bits), tag arrays of a set are padded to a multiple of it
+#define TAG_MATCH_VECTOR_WAYS 4
+
+/*
+ * @brief Way of a set whose tag equals `tag` and whose valid bit is set, -1 if none.
+ *
+ * @param tags tags of the set, 32-byte aligned, `n_ways` a multiple of TAG_MATCH_VECTOR_WAYS
+ * @param valid_bits valid bitmask of the set (bit i of word i / 64 = way i), 0 for padding ways
+ *
+ * Compares a broadcast tag with 4 (AVX2) or 2 (SSE4.1) ways at a time, picked once from the CPU features;
+ * the scalar loop is used on other CPUs or when built with -DCACHE_SCALAR_TAGS.
+ */
+int findMatchingWay(const uint64_t* tags, const uint64_t* valid_bits, uint n_ways, uint64_t tag);
+
+/*
+ * @brief "avx2", "sse4.1" or "scalar": the tag compare findMatchingWay runs
+ */
+const char* getTagMatchKernelName();
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include<vector>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<functional>
+#include<memory>
+using namespace std;
+
+/*
+ * @brief Fixed set of worker threads with one task queue per worker and work stealing.
+ *
+ * Tasks are dealt round-robin onto the worker queues. A worker runs its own queue newest first and,
+ * once that is empty, steals the oldest task of another worker, so uneven tasks still keep every core busy.
+ */
+class ThreadPool
+{
+private:
+    struct WorkerQueue
+    {
+        mutex queue_mutex;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<WorkerQueue>> queues;
+    vector<thread> workers;
+    size_t next_queue;
+
+    atomic<size_t> n_queued;     // tasks waiting in the queues
+    atomic<size_t> n_pending;    // tasks submitted and not finished yet
+    bool isStopping;
+
+    mutex wait_mutex;
+    condition_variable wake_cv;     // workers wait for tasks
+    condition_variable done_cv;     // waitAll waits for n_pending == 0
+
+    /*
+     * @brief Takes the newest task of `worker`'s queue, else steals the oldest task of another queue
+     * @return false if all queues are empty
+     */
+    bool popTask(uint worker, function<void()>& task);
+
+    void workerLoop(uint worker);
+
+public:
+    /*
+     * @param n_threads number of workers (at least 1)
+     */
+    ThreadPool(uint n_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(function<void()> task);
+
+    /*
+     * @brief Returns once every submitted task has finished
+     */
+    void waitAll();
+
+    uint getThreadCount() {return workers.size();}
+};
+
+#endif
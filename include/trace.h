@@ -1,28 +1,290 @@
-// #ifndef TRACE_H
-// #define TRACE_H
-
-// #include<iostream>
-// #include<vector>
-// #include<string>
-// #include<fstream>
-// using namespace std;
-
-// struct TraceEntry
-// {
-//     string operation;
-//     long long int addr;
-
-//     TraceEntry(string op, long long int addr) {operation = op; this->addr = addr;}
-// };
-
-
-// // class Trace
-// // {
-// // private:
-// //     string traceFileName;
-// // public:
-// //     Trace(string fileName);
-// //     vector<TraceEntry> parseTraceFile();
-// // };
-
-// #endif
\ No newline at end of file
+#ifndef TRACE_H
+#define TRACE_H
+
+#include<iostream>
+#include<vector>
+#include<string>
+#include<cstdint>
+#include<cstdio>
+#include<memory>
+using namespace std;
+
+// Accesses decoded per batch when a trace is streamed
+#define TRACE_BATCH_SIZE 4096
+
+// Most accesses one record of any format decodes to (a ChampSim instruction: fetch + 4 loads + 2 stores)
+#define TRACE_MAX_ENTRIES_PER_RECORD 7
+
+/*
+ * @brief One decoded trace access. Plain data so that a whole trace is one flat array
+ */
+struct TraceEntry
+{
+    long long int addr;
+    char operation;     // 'r' or 'w'
+    uint32_t size;      // bytes accessed, 0 if the trace does not say (then the access stays within one block)
+    uint64_t pc;        // program counter of the access, 0 if the trace does not say
+};
+
+
+/*
+ * Binary trace format (little-endian):
+ *   header   BinaryTraceHeader (24 bytes)
+ *   records  n_records x (1 byte op (0 = read, 1 = write) + addr_width bytes address)
+ */
+#define BINARY_TRACE_MAGIC "CSIMBTRC"
+#define BINARY_TRACE_VERSION 1
+
+struct BinaryTraceHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint8_t addr_width;     // bytes per address: 4 or 8
+    uint8_t reserved;
+    uint32_t flags;
+    uint64_t n_records;
+};
+static_assert(sizeof(BinaryTraceHeader) == 24, "binary trace header must be packed");
+
+
+/*
+ * Compressed trace format (little-endian):
+ *   header   CompressedTraceHeader (32 bytes)
+ *   blocks   n_blocks x (CompressedBlockHeader + payload_bytes of records)
+ *
+ * A record is a varint of (zigzag(addr - previous addr) << 1 | op), op 0 = read, 1 = write.
+ * The previous address restarts at 0 in every block, so blocks decode independently.
+ */
+#define COMPRESSED_TRACE_MAGIC "CSIMCTRC"
+#define COMPRESSED_TRACE_VERSION 1
+#define COMPRESSED_BLOCK_RECORDS 65536
+
+struct CompressedTraceHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t block_records;     // maximum records per block
+    uint64_t n_records;
+    uint64_t n_blocks;
+};
+static_assert(sizeof(CompressedTraceHeader) == 32, "compressed trace header must be packed");
+
+struct CompressedBlockHeader
+{
+    uint32_t payload_bytes;
+    uint32_t n_records;
+};
+
+
+enum class TraceFormat
+{
+    AUTO,           // detected from the start of the trace
+    TEXT,
+    BINARY,
+    COMPRESSED,
+    DINERO,         // decoded by a TraceAdapter (traceAdapter.h)
+    LACKEY,
+    CHAMPSIM
+};
+
+/*
+ * @brief Maps a format name (auto, text, binary, compressed, din, lackey, champsim) to its TraceFormat
+ * @return false if the name is unknown
+ */
+bool parseTraceFormat(const string& name, TraceFormat& format);
+
+
+class TraceAdapter;
+
+
+/*
+ * @brief Trace file mapped read-only into memory, or a trace stream (stdin / named pipe) read through a bounded buffer.
+ *
+ * Text traces (`r <hex> [<size> [<hex pc>]]` / `w ...` per line), binary and compressed traces are decoded in place from
+ * the mapping (or buffer), no per-access allocation. Foreign formats (din, lackey, ChampSim) are decoded
+ * record by record by a TraceAdapter. The format is detected from the start of the trace unless it is given.
+ */
+class Trace
+{
+private:
+    string traceFilePath;
+    int fd;
+    const char* data;       // mapped file, or the valid part of stream_buffer
+    size_t size;
+    bool isFileOpen;
+
+    // Streams cannot be mapped, they are read into a buffer that is refilled as it is consumed
+    bool isStream;
+    bool isStreamEOF;
+    vector<char> stream_buffer;
+
+    TraceFormat format;
+    bool isIFetchIncluded;
+    unique_ptr<TraceAdapter> adapter;   // foreign formats only
+    BinaryTraceHeader binary_header;
+    CompressedTraceHeader compressed_header;
+    const char* records;    // start of binary records / compressed blocks / text lines
+
+    // Streaming position (readBatch)
+    const char* cursor;     // next text line / binary record / compressed block header
+    size_t n_lines_read;
+    size_t n_records_read;
+
+    // Compressed block being streamed
+    const unsigned char* block_pos;
+    const unsigned char* block_end;
+    uint32_t block_remaining;
+    uint64_t block_prev_addr;
+    size_t n_blocks_read;
+
+    /*
+     * @brief Number of lines in [begin, end) (a last line without newline is counted too)
+     */
+    static size_t countLines(const char* begin, const char* end);
+
+    /*
+     * @brief Decodes [begin, end), which must start at the beginning of a line, into `entries`
+     * @param error_line line (relative to chunk) of first malformed line, 0 if none
+     * @return number of entries written (blank lines are skipped)
+     */
+    static size_t parseChunk(const char* begin, const char* end, TraceEntry* entries, size_t& error_line);
+
+    /*
+     * @brief Decodes `n_records` binary records starting at `first_record` into `entries`
+     * @return index of first invalid record, n_records if all are valid
+     */
+    size_t decodeRecords(const char* first_record, size_t n_records, TraceEntry* entries);
+
+    /*
+     * @brief Decodes `n_records` varint records from [pos, end), advancing `pos` and `prev_addr`
+     * @return false if the records run past `end`
+     */
+    static bool decodeCompressedRecords(const unsigned char*& pos, const unsigned char* end, size_t n_records,
+                                        uint64_t& prev_addr, TraceEntry* entries);
+
+    /*
+     * @brief Reads the header of the compressed block at `block`, exits on a truncated block
+     * @return start of the block's payload
+     */
+    const char* nextCompressedBlock(const char* block, CompressedBlockHeader& block_header, size_t block_index);
+
+    /*
+     * @brief (streams) Moves the unread bytes to the front of the buffer and reads more behind them
+     * @return false once the end of the stream has been reached before
+     */
+    bool refillStream();
+
+    /*
+     * @brief Makes at least `n_bytes` unread bytes available at `cursor`, refilling the stream if needed
+     * @return false if the trace ends before that
+     */
+    bool ensureAvailable(size_t n_bytes);
+
+    /*
+     * @brief (foreign formats) Decodes whole records through the adapter until `max_entries` could be exceeded
+     */
+    size_t readAdapterBatch(TraceEntry* entries, size_t max_entries);
+
+    void detectFormat(TraceFormat requested_format);
+    size_t binaryRecordSize() {return 1 + binary_header.addr_width;}
+
+public:
+    /*
+     * @param filePath path of the trace, "-" for stdin
+     * @param requested_format format of a trace without a header (din, lackey, ChampSim, text), AUTO to detect it
+     * @param isIFetchIncluded whether instruction fetches of foreign formats are simulated (as reads)
+     */
+    Trace(string filePath, TraceFormat requested_format = TraceFormat::AUTO, bool isIFetchIncluded = true);
+    ~Trace();
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    bool isOpen() {return isFileOpen;}
+    TraceFormat getFormat() {return format;}
+
+    /*
+     * @brief Whether the trace is a stream (stdin / pipe): it can only be read once
+     */
+    bool isStreamed() {return isStream;}
+
+    /*
+     * @brief Decodes the whole trace into a flat array.
+     *
+     * Large files are split at newline (or record / block) boundaries and the chunks are decoded by `n_threads` threads
+     * (streams and foreign formats are decoded by the calling thread). Exits with the line number of the first malformed line.
+     */
+    vector<TraceEntry> parseTraceFile(uint n_threads);
+
+    /*
+     * @brief Streams the trace: decodes the next (at most) `max_entries` accesses
+     *
+     * Foreign formats decode whole records, so `max_entries` must be at least TRACE_MAX_ENTRIES_PER_RECORD.
+     * @return number of entries written, 0 at end of trace
+     */
+    size_t readBatch(TraceEntry* entries, size_t max_entries);
+};
+
+
+/*
+ * @brief Writes accesses into a trace file of one of the non-text formats (access sizes and PCs are not kept)
+ */
+class TraceWriter
+{
+public:
+    virtual ~TraceWriter() {}
+
+    virtual bool isOpen() = 0;
+    virtual void write(const TraceEntry& entry) = 0;
+
+    /*
+     * @brief Writes the final counts into the header and closes the file
+     * @return false on I/O error
+     */
+    virtual bool close() = 0;
+};
+
+
+class BinaryTraceWriter : public TraceWriter
+{
+private:
+    FILE* file;
+    BinaryTraceHeader header;
+    vector<unsigned char> buffer;
+
+    void flushBuffer();
+
+public:
+    /*
+     * @param addr_width bytes per address: 4 or 8
+     */
+    BinaryTraceWriter(string filePath, uint addr_width);
+    ~BinaryTraceWriter();
+
+    bool isOpen() {return file != nullptr;}
+    void write(const TraceEntry& entry);
+    bool close();
+};
+
+
+class CompressedTraceWriter : public TraceWriter
+{
+private:
+    FILE* file;
+    CompressedTraceHeader header;
+    vector<unsigned char> block;    // payload of the block being filled
+    uint32_t block_records;
+    uint64_t prev_addr;
+
+    void flushBlock();
+
+public:
+    CompressedTraceWriter(string filePath, uint32_t max_block_records = COMPRESSED_BLOCK_RECORDS);
+    ~CompressedTraceWriter();
+
+    bool isOpen() {return file != nullptr;}
+    void write(const TraceEntry& entry);
+    bool close();
+};
+
+#endif
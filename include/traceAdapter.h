@@ -0,0 +1,175 @@
+#ifndef TRACE_ADAPTER_H
+#define TRACE_ADAPTER_H
+
+#include "trace.h"
+using namespace std;
+
+/****************************
+ ****** TEXT HELPERS ********
+****************************/
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+/*
+ * @return value of the hex digit, -1 if `c` is not a hex digit
+ */
+static inline int hexDigitValue(char c)
+{
+    unsigned int digit = c - '0';
+    if(digit < 10) return digit;
+
+    digit = (c | 0x20) - 'a';   // lower-casing
+    if(digit < 6) return digit + 10;
+
+    return -1;
+}
+
+
+/*
+ * @brief Parses a 64-bit hex number with an optional 0x prefix at `p`, advancing `p` past it
+ * @return false if there are no hex digits or more than 16
+ */
+static inline bool parseHex(const char*& p, const char* end, unsigned long long int& value)
+{
+    if(end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hexDigitValue(p[2]) >= 0) p += 2;
+
+    value = 0;
+    int n_digits = 0;
+    int digit;
+    while(p < end && (digit = hexDigitValue(*p)) >= 0)
+    {
+        value = (value << 4) | digit;
+        n_digits++;
+        p++;
+    }
+    return n_digits > 0 && n_digits <= 16;
+}
+
+
+/****************************
+ ****** TRACE ADAPTERS ******
+****************************/
+
+/*
+ * @brief Decodes the records of a foreign trace format into simulator accesses.
+ *
+ * The Trace that owns the adapter supplies the bytes (mapping or stream buffer) record by record:
+ * a line without its newline for text formats, getRecordSize() bytes for fixed-size binary formats.
+ * The simulator only has reads and writes, so instruction fetches become reads (or are dropped).
+ */
+class TraceAdapter
+{
+protected:
+    bool isIFetchIncluded;
+
+public:
+    TraceAdapter(bool isIFetchIncluded) {this->isIFetchIncluded = isIFetchIncluded;}
+    virtual ~TraceAdapter() {}
+
+    virtual string getName() = 0;
+
+    /*
+     * @brief Bytes per record, 0 for line based (text) formats
+     */
+    virtual size_t getRecordSize() {return 0;}
+
+    /*
+     * @brief Most accesses a single record can decode to
+     */
+    virtual size_t getMaxEntriesPerRecord() = 0;
+
+    /*
+     * @brief Decodes the record [begin, end) into `entries`
+     * @param n_entries number of entries written (0 for comments, blank lines and ignored records)
+     * @return false if the record is malformed
+     */
+    virtual bool decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries) = 0;
+};
+
+
+/*
+ * @brief Dinero III `din` traces: `<label> <hex address>` per line.
+ *
+ * Labels: 0 = data read, 1 = data write, 2 = instruction fetch, 3 = escape (ignored), 4 = cache flush (ignored).
+ * Fields after the address are ignored.
+ */
+class DineroTraceAdapter : public TraceAdapter
+{
+public:
+    DineroTraceAdapter(bool isIFetchIncluded) : TraceAdapter(isIFetchIncluded) {}
+
+    string getName() {return "din";}
+    size_t getMaxEntriesPerRecord() {return 1;}
+    bool decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries);
+
+    /*
+     * @brief Whether the start of a trace looks like a din trace
+     */
+    static bool matches(const char* begin, const char* end);
+};
+
+
+/*
+ * @brief Valgrind lackey (`--trace-mem=yes`) traces: `I  <hex>,<size>`, ` L <hex>,<size>`, ` S <hex>,<size>`, ` M <hex>,<size>`.
+ *
+ * A modify (M) is a load followed by a store to the same address. Valgrind's `==pid==` lines are skipped.
+ * Data accesses get the address of the last instruction fetch as their PC.
+ */
+class LackeyTraceAdapter : public TraceAdapter
+{
+private:
+    uint64_t last_ifetch_addr = 0;
+
+public:
+    LackeyTraceAdapter(bool isIFetchIncluded) : TraceAdapter(isIFetchIncluded) {}
+
+    string getName() {return "lackey";}
+    size_t getMaxEntriesPerRecord() {return 2;}
+    bool decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries);
+
+    static bool matches(const char* begin, const char* end);
+};
+
+
+/*
+ * ChampSim instruction record (64 bytes, little-endian, no file header)
+ */
+struct ChampSimRecord
+{
+    uint64_t ip;
+    uint8_t is_branch;
+    uint8_t branch_taken;
+    uint8_t destination_registers[2];
+    uint8_t source_registers[4];
+    uint64_t destination_memory[2];     // stores, 0 = unused
+    uint64_t source_memory[4];          // loads, 0 = unused
+};
+static_assert(sizeof(ChampSimRecord) == 64, "ChampSim record must be packed");
+
+/*
+ * @brief ChampSim-style binary traces: every record is one instruction.
+ *
+ * An instruction decodes to its fetch, then its loads, then its stores (ChampSim's order), all with the
+ * instruction pointer as PC. Access sizes are not recorded.
+ */
+class ChampSimTraceAdapter : public TraceAdapter
+{
+public:
+    ChampSimTraceAdapter(bool isIFetchIncluded) : TraceAdapter(isIFetchIncluded) {}
+
+    string getName() {return "champsim";}
+    size_t getRecordSize() {return sizeof(ChampSimRecord);}
+    size_t getMaxEntriesPerRecord() {return 7;}
+    bool decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries);
+
+    /*
+     * @brief Whether the start of a trace is binary data (and not text)
+     */
+    static bool matches(const char* begin, const char* end);
+};
+
+#endif
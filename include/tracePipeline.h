@@ -0,0 +1,56 @@
+#ifndef TRACE_PIPELINE_H
+#define TRACE_PIPELINE_H
+
+#include<iostream>
+#include "trace.h"
+#include "cacheSimulator.h"
+#include "ringBuffer.h"
+#include "progressReporter.h"
+using namespace std;
+
+// Batches in flight between the reader thread and the simulator
+#define PIPELINE_RING_BATCHES 16
+
+struct TraceBatch
+{
+    size_t n_entries;       // 0 marks the end of the trace
+    TraceEntry entries[TRACE_BATCH_SIZE];
+};
+
+struct PipelineStatistics
+{
+    size_t n_batches = 0;
+    size_t n_accesses = 0;
+    size_t n_reader_stalls = 0;       // reader found the ring full (simulator is the bottleneck)
+    size_t n_simulator_stalls = 0;    // simulator found the ring empty (decoding is the bottleneck)
+
+    void printStats();
+};
+
+
+/*
+ * @brief Overlaps trace decoding with simulation.
+ *
+ * A reader thread decodes the trace batch by batch directly into the slots of a lock-free ring,
+ * the calling thread drains the ring into the simulator in trace order.
+ */
+class TracePipeline
+{
+private:
+    SPSCRingBuffer<TraceBatch> ring;
+    PipelineStatistics pipeline_stats;
+
+    void readTrace(Trace& trace);
+
+public:
+    TracePipeline();
+
+    /*
+     * @brief Simulates the whole trace, returns once the last access has been simulated
+     */
+    void run(Trace& trace, CacheSimulator& cache_sim, ProgressReporter& progress);
+
+    PipelineStatistics getPipelineStats() {return pipeline_stats;}
+};
+
+#endif
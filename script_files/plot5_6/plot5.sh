@@ -7,16 +7,21 @@ BLOCKSIZE=32  # Fixed block size
 
 # Loop through L1 and L2 cache sizes
 for L1 in "${L1_SIZES[@]}"; do
+    # L1 does not depend on L2: simulate it once and record the requests it sends to L2
+    FILTER_TRACE=$(mktemp)
+    ./cache_sim $L1 4 32 0 0 0 gcc_trace.txt --record-l2=$FILTER_TRACE > /dev/null
+
     for L2 in "${L2_SIZES[@]}"; do
         # Only run if L1 is smaller than L2
         if [ $L1 -lt $L2 ]; then
             # Run the cache simulator and capture the output
             # Assuming the program outputs AAT in a readable format
-            ./cache_sim $L1 4 32 0 $L2 8 gcc_trace.txt
+            ./cache_sim --replay-l2 $FILTER_TRACE $L2 8
             
             # Append the results to the output file
         fi
     done
+    rm -f $FILTER_TRACE
 done
 
 echo "Simulation complete. Results saved to $OUTPUT_FILE."
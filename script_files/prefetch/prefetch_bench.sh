@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Simulation throughput (accesses/s) with and without software prefetching of the L1 / L2 set metadata.
+# Usage: ./script_files/prefetch/prefetch_bench.sh [trace_file] [prefetch distance]
+# Binary traces (see trace_convert) measure the simulation rather than the text parsing. Prefetching pays off when
+# the sets a trace touches outgrow the host's caches (large L2 and a large footprint).
+
+trace_file=${1:-gcc_trace.txt}
+distance=${2:-8}
+
+# <L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC>
+configs=(
+  "32768 8 64 0 262144 16"
+  "32768 8 64 0 16777216 16"
+  "32768 8 64 0 268435456 16"
+  "1048576 8 64 0 1073741824 16"
+)
+
+for config in "${configs[@]}"; do
+  for prefetch in 0 "$distance"; do
+    # --progress prints the accesses/s of the whole run on its last line
+    rate=$(./cache_sim $config "$trace_file" --progress --prefetch=$prefetch 2>&1 >/dev/null | grep "done" | sed 's/.*(\(.*\) M accesses\/s)/\1/')
+    echo "$config  prefetch=$prefetch  $rate M accesses/s"
+  done
+done
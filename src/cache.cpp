@@ -1,5 +1,5 @@
 #include "cache.h"
-#include "parse.h"
+#include "cactiMemo.h"
 #include<cmath>
 #include<algorithm>
 
@@ -28,7 +28,7 @@ CacheBlock::CacheBlock()
  **** CACHE CONSTRUCTORS ****
 ****************************/
  
-Cache::Cache(int cache_size, int assoc, int block_size, int n_vc_blocks)
+Cache::Cache(MetadataArena* arena, int cache_size, int assoc, int block_size, int n_vc_blocks, ReplacementPolicyKind policy_kind)
 {
     this->cache_size = cache_size;
     this->assoc = assoc;
@@ -50,23 +50,32 @@ Cache::Cache(int cache_size, int assoc, int block_size, int n_vc_blocks)
         uint vc_assoc = n_vc_blocks;
         uint victimCache_n_vc_blocks = 0;
 
-        vc_cache = new Cache(vc_cache_size, vc_assoc, vc_block_size, victimCache_n_vc_blocks);
+        vc_cache = make_unique<Cache>(arena, vc_cache_size, vc_assoc, vc_block_size, victimCache_n_vc_blocks, policy_kind);
     }
     else
     {
-        vc_cache = new Cache();
+        vc_cache = make_unique<Cache>();
     }
 
-    cache = vector<vector<CacheBlock>> (n_sets, vector<CacheBlock>(assoc, CacheBlock()));
+    tag_stride = (assoc + TAG_MATCH_VECTOR_WAYS - 1) / TAG_MATCH_VECTOR_WAYS * TAG_MATCH_VECTOR_WAYS;
+    n_maskWords = (tag_stride + 63) / 64;
+    uint n_stateWords = (2 * n_maskWords + TAG_MATCH_VECTOR_WAYS - 1) / TAG_MATCH_VECTOR_WAYS * TAG_MATCH_VECTOR_WAYS;
+    sets = SetPageTable<uint64_t, CACHE_LINE_SIZE>(arena, n_sets, tag_stride + n_stateWords);
 
-    for(int i = 0; i < n_sets; i++)
+    // Highly associative sets find their tags in a hash table instead of a scan
+    isTagIndexed = assoc >= FA_ENGINE_MIN_ASSOC;
+    n_indexSlots = 0;
+    if(isTagIndexed)
     {
-        for(int j = 0; j < assoc; j++)
-        {
-            cache[i][j].lru_counter = j;
-        }
+        n_indexSlots = FullyAssociativeSet::findSlotCount(assoc);
+        tag_indexes = SetPageTable<FullyAssociativeSlot>(arena, n_sets, n_indexSlots);
     }
 
+    this->policy_kind = policy_kind;
+    replacement = makeReplacementPolicy(arena, policy_kind, n_sets, assoc);
+
+    isPCStatsEnabled = false;
+    isWarming = false;
     findCactiCacheStatistics();
     c_stats.vc_statistics = &(vc_cache->c_stats);
 }
@@ -78,10 +87,16 @@ Cache::Cache()
     assoc = 0;
     block_size = 0;
     n_sets = 0;
+    tag_stride = 0;
+    n_maskWords = 0;
+    isTagIndexed = false;
+    n_indexSlots = 0;
+    policy_kind = ReplacementPolicyKind::LRU;
     isVCEnabled = false;
     n_vc_blocks = 0;
-    vc_cache = nullptr; 
     c_stats.vc_statistics = nullptr;
+    isPCStatsEnabled = false;
+    isWarming = false;
 }
 
 
@@ -89,52 +104,16 @@ Cache::Cache()
  * CACHE PRIVATE FUNCTIONS *
 ****************************/
  
+template<typename Kernel>
 pair<bool, int> Cache::lookupBlock(int set_num, long long int tag)
 {
-    int max_lru_val = -1;
-    int max_lru_idx = -1;
-    int invalid_idx = -1;
-    int hit_idx = -1;
-
-    for(int i = 0; i < assoc; i++)
+    int hit_idx;
+    if(Kernel::isGeneric && isTagIndexed)
+        hit_idx = getTagIndex(set_num).find(tag);
+    else
     {
-        if(cache[set_num][i].valid_bit == true && cache[set_num][i].tag == tag)
-        {
-            hit_idx = i;
-            break;
-        }
-        // else if(invalid_idx == -1)
-        // {
-        //     // std::cout << cache[set_num][i].lru_counter << " " << max_lru_val << endl;
-        //     if(cache[set_num][i].valid_bit == false)
-        //     {
-        //         // std::cout << "nope" << endl;
-        //         invalid_idx = i;
-        //     }
-        //     else if(cache[set_num][i].lru_counter > max_lru_val)
-        //     {
-        //         // std::cout << "bool : " << cache[set_num][i].lru_counter << " " << max_lru_val << " " << (cache[set_num][i].lru_counter > max_lru_val) << endl;
-        //         // if()
-        //         // {
-        //              max_lru_val = cache[set_num][i].lru_counter;
-        //             max_lru_idx = i;
-        //             // std::cout << "true " << i << endl;
-        //         // }
-        //         // else
-        //         // {
-        //         //     std::cout << "false" <<  cache[set_num][i].lru_counter << " " << max_lru_val << endl;
-        //         // }
-        //     }
-            
-        // }
-        else
-        {
-            if(cache[set_num][i].lru_counter > max_lru_val)
-            {
-                max_lru_val = cache[set_num][i].lru_counter;
-                max_lru_idx = i;
-            }
-        }
+        const uint64_t* set_tags = getSetTags(set_num);
+        hit_idx = Kernel::findMatchingWay(set_tags, set_tags + tag_stride, tag_stride, tag);
     }
 
     bool isHit = (hit_idx == -1) ? false : true;
@@ -144,63 +123,18 @@ pair<bool, int> Cache::lookupBlock(int set_num, long long int tag)
     {
         return_idx = hit_idx;
     }
-    // else if(invalid_idx != -1) // invalid block exists
-    // {
-    //     return_idx = invalid_idx;
-    // }
     else
     {
-        return_idx = max_lru_idx;
+        return_idx = findLRUBlock<Kernel>(set_num);
     }
-
-    // std::cout << "Indices: " << dec << hit_idx << " " << invalid_idx << " " << max_lru_idx << endl;
-    // std::cout << "Counters: ";
-    // for(int i = 0; i < assoc; i++)
-    // {
-    //     std::cout << cache[set_num][i].lru_counter << " ";
-    // }
-    // std::cout << endl;
     return make_pair(isHit, return_idx);
 }
 
 
-int Cache::findLRUBlock(int set_num)
-{
-    int max_val = -1;
-    int max_idx = -1;
-
-    for(int i = 0; i < assoc; i++)
-    {
-        // if(cache[set_num][i].valid_bit == false)
-        // {
-        //     max_idx = i;
-        //     break;
-        // }
-        if(cache[set_num][i].lru_counter > max_val) 
-        {
-            max_val = cache[set_num][i].lru_counter;
-            max_idx = i;
-        }
-    }
-    return max_idx;
-}
-
-
-void Cache::incrementLRUCounters(int set_num, int idx)
-{
-    int cur_counter = cache[set_num][idx].lru_counter;
-
-    for(int i = 0; i < assoc; i++)
-    {
-        if(cache[set_num][i].lru_counter < cur_counter) cache[set_num][i].lru_counter++;
-    }
-}
-
-
 void Cache::swapBlocks(int l1_set_num, int l1_idx, int vc_idx)
 {
-    CacheBlock l1_block = cache[l1_set_num][l1_idx];
-    CacheBlock vc_block = vc_cache->cache[0][vc_idx];
+    CacheBlock l1_block = readBlock(l1_set_num, l1_idx);
+    CacheBlock vc_block = vc_cache->readBlock(0, vc_idx);
 
     // std::cout << "L1-VC Swap " << l1_idx << " " << vc_idx << endl;
 
@@ -219,26 +153,41 @@ void Cache::swapBlocks(int l1_set_num, int l1_idx, int vc_idx)
         new_vc_block_tag = getTag(vc_block_addr);
     }
 
+    // Blocks trade places, the LRU state stays with the positions (the VC way was just promoted by its hit)
     l1_block.tag = new_l1_block_tag;
-    l1_block.lru_counter = 0;
     vc_block.tag = new_vc_block_tag;
-    vc_block.lru_counter = 0;
 
-    vc_cache->cache[0][vc_idx] = l1_block;
-    cache[l1_set_num][l1_idx] = vc_block;
+    vc_cache->storeBlock(0, vc_idx, l1_block);
+    storeBlock(l1_set_num, l1_idx, vc_block);
     // std::cout << "During Swap : " << vc_cache->cache[0][vc_idx].tag << endl; 
 }
 
 
+void Cache::findCactiResults(uint cache_size, uint block_size, uint assoc, float& hitTime, float& energy, float& area)
+{
+    CactiResult result = CactiMemo::getInstance().find(cache_size, block_size, assoc);
+    hitTime = result.hitTime;
+    energy = result.energy;
+    area = result.area;
+}
+
+
 void Cache::findCactiCacheStatistics()
 {
-    int cacti_result = get_cacti_results(cache_size, block_size, assoc, &c_stats.hitTime, &c_stats.energy, &c_stats.area);
-    
-    if(cacti_result > 0)    // Cacti failed for this cache configuration
-    {
-        // std::cout << "CACTI FAILED" << cacti_result << endl;
-        c_stats.hitTime = 0.2;
-    }
+    findCactiResults(cache_size, block_size, assoc, c_stats.hitTime, c_stats.energy, c_stats.area);
+}
+
+
+void Cache::setCacheStatistics(const CacheStatistics& stats)
+{
+    c_stats.n_reads = stats.n_reads;
+    c_stats.n_read_misses = stats.n_read_misses;
+    c_stats.n_writes = stats.n_writes;
+    c_stats.n_write_misses = stats.n_write_misses;
+    c_stats.n_swap_requests = stats.n_swap_requests;
+    c_stats.n_swaps = stats.n_swaps;
+    c_stats.n_writebacks = stats.n_writebacks;
+    c_stats.n_back_invalidations = stats.n_back_invalidations;
 }
 
 
@@ -246,8 +195,9 @@ void Cache::printCacheSet(int set_num)
 {
     std::cout << "  set " << hex << set_num << ":\t";
 
-        for(auto cb: cache[set_num])
+        for(uint i = 0; i < assoc; i++)
         {
+            CacheBlock cb = readBlock(set_num, i);
             cout << hex << cb.tag << endl;
             if(cb.dirty_bit == true)
                 std::cout << " D\t";
@@ -263,238 +213,120 @@ void Cache::printCacheSet(int set_num)
  * CACHE PUBLIC FUNCTIONS *
 ****************************/
  
-pair<bool, pair<int, CacheBlock>> Cache::lookupRead(long long int addr)
+template<AccessType TYPE, typename Kernel>
+AccessResult Cache::access(long long int addr, uint64_t pc)
 {
-    c_stats.n_reads++;  // Read request
-    pair<bool, pair<int, CacheBlock>> result = make_pair(false, make_pair(-1, CacheBlock(0)));
-
-    int set_num = getSetNumber(addr);
-    long long int tag = getTag(addr);
-    // std::cout << "Read: addr: ";
-    // cout << hex << addr ;
-    // std::cout << " set: " << set_num << "    tag: ";
-    // cout << hex << tag ;
-    // std::cout << endl;
-    
-    // std::cout << "Before Read: " << endl; 
-    // printCacheSet(set_num);
-
-    pair<bool, int> lookupResult = lookupBlock(set_num, tag);
-    int lru_counter = cache[set_num][lookupResult.second].lru_counter;
-
-    if(lookupResult.first == true) // cache hit
+    constexpr bool isWrite = (TYPE == AccessType::WRITE);
+    if(!isWarming)
     {
-        // std::cout << "ReadHit\n" << endl;
-        result.first = true;
-        result.second.first = lookupResult.second;
-        result.second.second = cache[set_num][lookupResult.second];
+        if(isWrite) c_stats.n_writes++;
+        else c_stats.n_reads++;
     }
-    else    // cache_miss
-    {
-        // std::cout << "ReadMiss\n" << endl;
-        c_stats.n_read_misses++;
-        result.first = false;
-        result.second.first = lookupResult.second;
-        result.second.second = cache[set_num][lookupResult.second];
 
-        if(isVCEnabled) 
-        {
-            if(cache[set_num][result.second.first].valid_bit == true)
-            {
-                // Sends a read request to VC
-                // std::cout << "VC Cache Lookup" << endl;
-                auto vc_readResult = vc_cache->lookupRead(addr);
-                c_stats.n_swap_requests++;
-
-                if(vc_readResult.first == true) // VC hit
-                {
-                    swapBlocks(set_num, lookupResult.second, vc_readResult.second.first);
-                    cache[set_num][lookupResult.second].lru_counter = lru_counter;
-                    vc_cache->cache[0][vc_readResult.second.first].lru_counter = 0;
-                    result.first = true;
-                    result.second.second = cache[set_num][lookupResult.second];
-                    c_stats.n_swaps++;
-                }
-                else    // VC miss
-                {
-                    // Readblock function does not evict block in our prog
-                    // LRU of this cache should be placed in VC 
-                    // And also VC block should be generally evicted and passed down to next level of memory
-                    // Passing down is handled at simulator stage using `evictandReplaceBlock` functionality of Cache clas
-                    // So VC block is kept in L1 (as new block adding is also done in simulator class) to ensure correctness of that => Indirectly we are swapping again    (atleast in our prog)
-                    if(cache[set_num][lookupResult.second].valid_bit == true)
-                    {
-                        cache[set_num][lookupResult.second].tag = vc_cache->getTag(getBlockAddress(set_num, cache[set_num][lookupResult.second].tag));
-                        CacheBlock vc_evictedBlock = vc_cache->evictAndReplaceBlock(cache[set_num][lookupResult.second], 0, vc_readResult.second.first);
-                        cache[set_num][lookupResult.second].valid_bit = false;
-
-                        result.second.first = -1;   // indicating block is evicted from vc cache
-                        result.second.second = vc_evictedBlock;
-                        if(vc_evictedBlock.valid_bit == true && vc_evictedBlock.dirty_bit == true)   c_stats.n_writebacks++;
-                    }
-                }
-            }
-        }
-    }
+    AccessResult result;
+    result.set_num = getSetNumber<Kernel>(addr);
+    result.tag = getTag<Kernel>(addr);
+    result.victim = EvictedBlock();
 
+    pair<bool, int> lookupResult = lookupBlock<Kernel>(result.set_num, result.tag);
+    result.isHit = lookupResult.first;
+    result.idx = lookupResult.second;
 
-    // Checking if block to be evicted is dirty to count write_backs
-    if(result.first == true)   // finally if its a miss
+    if(result.isHit == false && !isWarming)
     {
-    //     if(cache[set_num][result.second].valid_bit == true && cache[set_num][result.second].dirty_bit == true)
-    //     {
-    //         std::cout << "Writeback - set: " << hex << set_num <<  " " << "tag - " << tag << endl;
-    //         c_stats.n_writebacks++; // write back to next level will be handled at simulator
-    //     }
-    //     // cache[set_num][lookupResult.second].lru_counter = 0;
-    // }
-    // else
-    // {
-        incrementLRUCounters(set_num, lookupResult.second);
-        cache[set_num][lookupResult.second].lru_counter = 0;
+        if(isWrite) c_stats.n_write_misses++;
+        else c_stats.n_read_misses++;
+        if(isPCStatsEnabled && pc != 0) pc_misses[pc]++;
     }
 
-    return result;
-}
-
-
-pair<bool, pair<int, CacheBlock>> Cache::lookupWrite(long long int addr)
-{
-    c_stats.n_writes++;
-    pair<bool, pair<int,CacheBlock>> result = make_pair(false, make_pair(-1, CacheBlock(0)));
-
-    int set_num = getSetNumber(addr);
-    long long int tag = getTag(addr);
-
-    pair<bool, int> lookupResult = lookupBlock(set_num, tag);
-    int lru_counter = cache[set_num][lookupResult.second].lru_counter;
-    // std::cout << "LookupResukt lru idx: " << lookupResult.second << " , counter : " << lru_counter << endl;
-
-    // std::cout << "Write: addr: ";
-    // cout << hex << addr ;
-    // std::cout << " set: " << hex << set_num << "    tag: ";
-    // cout << hex << tag;
-    // std::cout << endl;
-    
-    // std::cout << "Before Write: " << dec << lookupResult.second << endl; 
-    // printCacheSet(set_num);
-
-
-    if(lookupResult.first == true) // cache hit
-    {
-        // std::cout << "Write Hit\n" << endl;
-        result.first = true;
-        result.second.first = lookupResult.second;
-        result.second.second = cache[set_num][lookupResult.second];
-    }
-    else    // cache-write miss
+    if(result.isHit == false)   // cache miss
     {
-        // std::cout << "Write Miss\n" << endl;
-        c_stats.n_write_misses++;
-        result.first = false;
-        result.second.first = lookupResult.second;
-        result.second.second = cache[set_num][lookupResult.second];
 
-        if(isVCEnabled) 
+        if(isVCEnabled && isBlockValid(result.set_num, result.idx))
         {
-            if(cache[set_num][result.second.first].valid_bit == true)
+            // Sends a read request to VC
+            AccessResult vc_result = vc_cache->access<AccessType::READ>(addr, pc);
+            if(!isWarming) c_stats.n_swap_requests++;
+
+            if(vc_result.isHit) // VC hit
             {
-                // Sends a read request to VC
-                auto vc_readResult = vc_cache->lookupRead(addr);
-                c_stats.n_swap_requests++;
-
-                if(vc_readResult.first == true) // VC hit
-                {
-                    swapBlocks(set_num, lookupResult.second, vc_readResult.second.first);
-                    vc_cache->cache[0][vc_readResult.second.first].lru_counter = 0;
-                    cache[set_num][lookupResult.second].lru_counter = lru_counter;
-                    // std::cout << "Swap hit - counter " << 
-                    result.first = true;
-                    result.second.second = cache[set_num][lookupResult.second];
-                    c_stats.n_swaps++;
-                }
-                else    // VC miss
-                {
-                    // Writeblock function does not evict block in our prog
-                    // LRU of this cache should be placed in VC 
-                    // And also VC block should be generally evicted and passed down to next level of memory
-                    // Passing down is handled at simulator stage using `evictandReplaceBlock` functionality of Cache clas
-                    // So VC block is kept in L1 (as new block adding is also done in simulator class) to ensure correctness of that => Indirectly we are swapping again    (atleast in our prog)
-                    if(cache[set_num][lookupResult.second].valid_bit == true)
-                    {
-                        cache[set_num][lookupResult.second].tag = vc_cache->getTag(getBlockAddress(set_num, cache[set_num][lookupResult.second].tag));
-                        CacheBlock vc_evictedBlock = vc_cache->evictAndReplaceBlock(cache[set_num][lookupResult.second], 0, vc_readResult.second.first);
-                        cache[set_num][lookupResult.second].valid_bit = false;
-
-                        result.second.first = -1;   // indicating block is evicted from vc cache
-                        result.second.second = vc_evictedBlock;
-                        if(vc_evictedBlock.valid_bit == true && vc_evictedBlock.dirty_bit == true)   c_stats.n_writebacks++;
-                    }
-                    // CacheBlock vc_evictedBlock = vc_cache->evictAndReplaceBlock(cache[set_num][lookupResult.second], 0, vc_readResult.second.first);
-                    // cache[set_num][lookupResult.second].valid_bit = false;
-
-                    // result.second.first = -1;   // indicating block is evicted from vc cache
-                    // result.second.second = vc_evictedBlock;
-                    // if(vc_evictedBlock.dirty_bit == true)   c_stats.n_writebacks++;
-                }
+                swapBlocks(result.set_num, result.idx, vc_result.idx);
+                result.isHit = true;
+                if(!isWarming) c_stats.n_swaps++;
+            }
+            else    // VC miss
+            {
+                // The victim of the way moves to the VC now, the way is left invalid for the new block (placed by
+                // the simulator with fill) and the block the VC evicts is the one passed down
+                long long int victim_addr = getBlockAddress<Kernel>(result.set_num, getSetTags(result.set_num)[result.idx]);
+                bool isVictimDirty = isBlockDirty(result.set_num, result.idx);
+                result.victim = vc_cache->fillBlock(0, vc_result.idx, vc_cache->getTag(victim_addr), isVictimDirty);
+                clearValid(result.set_num, result.idx);
+
+                result.idx = -1;   // indicating block is evicted from vc cache
+                if(result.victim.isDirty && !isWarming) c_stats.n_writebacks++;
             }
         }
     }
 
-    // std::cout << "After increment counters - " << cache[set_num][lookupResult.second].lru_counter << " : ";
-    // for(int i = 0; i < assoc; i++)
-    // {
-    //     std::cout << cache[set_num][i].lru_counter << " ";
-    // }
-    // std::cout << endl;
-
-    // Checking if block to be evicted is dirty to count write_backs
-    if(result.first == true)   
+    if(result.isHit)
     {
-    //     if(cache[set_num][result.second].valid_bit == true && cache[set_num][result.second].dirty_bit == true)
-    //     {
-    //         std::cout << "Writeback - set: " << hex << set_num <<  " " << "tag - " << tag << endl;
-    //         c_stats.n_writebacks++; // write back to next level will be handled at simulator
-    //     }
-    //     // cache[set_num][lookupResult.second].lru_counter = 0;
-    // }
-    // else
-    // {
-        incrementLRUCounters(set_num, lookupResult.second);
-        cache[set_num][lookupResult.second].lru_counter = 0;
-
-        // std::cout << "After increment counters - " << cache[set_num][lookupResult.second].lru_counter << " : ";
-        // for(int i = 0; i < assoc; i++)
-        // {
-        //     std::cout << cache[set_num][i].lru_counter << " ";
-        // }
-        // std::cout << endl;
+        promoteBlock<Kernel>(result.set_num, result.idx);
+        if(isWrite) writeData(result.set_num, result.idx);
     }
-
     return result;
 }
 
 
-int Cache::getSetNumber(long long int addr)
+template<typename Kernel>
+EvictedBlock Cache::fill(const AccessResult& result, bool isDirty)
 {
-    long long int temp = addr >> n_blockOffsetBits; //block offset bits are removed
-    long long int mask = (1 << (n_indexBits)) -1;
-    return temp & mask;
+    EvictedBlock evicted = fillBlock<Kernel>(result.set_num, result.idx, result.tag, isDirty);
+    return (result.idx == -1) ? result.victim : evicted;
 }
 
 
-long long int Cache::getTag(long long int addr)
+template<typename Kernel>
+EvictedBlock Cache::fillBlock(int set_num, int idx, long long int tag, bool isDirty)
 {
-    long long int tag = (addr >> n_blockOffsetBits) >> n_indexBits; //block offset & index_bits bits are removed
-    return tag;
+    // idx will be invalid block idx if exists
+    if(idx == -1) idx = findLRUBlock<Kernel>(set_num);
+    visit([set_num, idx] (auto& policy) {policy.onFill(set_num, idx);}, replacement);
+
+    uint64_t* set_tags = getSetTags(set_num);
+    uint64_t& way_tag = set_tags[idx];
+    uint64_t* set_valid_bits = set_tags + tag_stride;
+    uint64_t* set_dirty_bits = set_valid_bits + n_maskWords;
+    EvictedBlock evicted;
+    evicted.addr = getBlockAddress<Kernel>(set_num, way_tag);
+    evicted.isValid = getBit(set_valid_bits, idx);
+    evicted.isDirty = evicted.isValid && getBit(set_dirty_bits, idx);
+    if(evicted.isDirty && !isWarming) c_stats.n_writebacks++;
+
+    if(isTagIndexed)
+    {
+        FullyAssociativeSet index = getTagIndex(set_num);
+        if(evicted.isValid) index.erase(way_tag);
+        index.insert(tag, idx);
+    }
+    way_tag = tag;
+    setBit(set_valid_bits, idx, true);
+    setBit(set_dirty_bits, idx, isDirty);
+    return evicted;
 }
 
 
-long long int Cache::getBlockAddress(int set_num, long long int tag)
-{
-    long long int addr = ((tag << n_blockOffsetBits) <<  n_indexBits) |  (set_num << n_blockOffsetBits);
-    return addr;
-}
+// Accesses of the generic kernel and of every specialized kernel (picked by CacheSimulator for L1)
+template AccessResult Cache::access<AccessType::READ, GenericCacheKernel>(long long int addr, uint64_t pc);
+template AccessResult Cache::access<AccessType::WRITE, GenericCacheKernel>(long long int addr, uint64_t pc);
+template EvictedBlock Cache::fill<GenericCacheKernel>(const AccessResult& result, bool isDirty);
+template EvictedBlock Cache::fillBlock<GenericCacheKernel>(int set_num, int idx, long long int tag, bool isDirty);
+
+#define INSTANTIATE_CACHE_KERNEL(assoc, block_size) \
+    template AccessResult Cache::access<AccessType::READ, CacheKernel<assoc, block_size>>(long long int addr, uint64_t pc); \
+    template AccessResult Cache::access<AccessType::WRITE, CacheKernel<assoc, block_size>>(long long int addr, uint64_t pc); \
+    template EvictedBlock Cache::fill<CacheKernel<assoc, block_size>>(const AccessResult& result, bool isDirty);
+CACHE_KERNEL_GRID(INSTANTIATE_CACHE_KERNEL)
 
 
 // void Cache::readData(int set_num, int idx)
@@ -506,41 +338,47 @@ long long int Cache::getBlockAddress(int set_num, long long int tag)
 void Cache::writeData(int set_num, int idx)
 {
     // since its simulation, data is not taken as arg to write
-    cache[set_num][idx].dirty_bit = true;
+    setBit(getDirtyBits(set_num), idx, true);
 }
 
 
 CacheBlock Cache::getBlock(int set_num, int idx)
 {
-    return cache[set_num][idx];
+    return readBlock(set_num, idx);
 }
 
 
-CacheBlock Cache::evictAndReplaceBlock(CacheBlock incoming_cache_block, int set_num, int lru_idx)
+CacheBlock Cache::readBlock(int set_num, int idx)
 {
-    // lru_idx will be invalid block idx if exists
-    if(lru_idx == -1)   lru_idx = findLRUBlock(set_num);
-
-    incrementLRUCounters(set_num, lru_idx);
+    CacheBlock block;
+    block.tag = getSetTags(set_num)[idx];
+    block.valid_bit = isBlockValid(set_num, idx);
+    block.dirty_bit = isBlockDirty(set_num, idx);
+    block.lru_counter = 0;      // the replacement state belongs to the policy
+    return block;
+}
 
-    CacheBlock lruCacheBlock = cache[set_num][lru_idx];
 
-    if(lruCacheBlock.valid_bit == true && lruCacheBlock.dirty_bit == true)
+void Cache::storeBlock(int set_num, int idx, const CacheBlock& block)
+{
+    uint64_t& tag = getSetTags(set_num)[idx];
+    if(isTagIndexed)
     {
-        c_stats.n_writebacks++;
+        FullyAssociativeSet index = getTagIndex(set_num);
+        if(isBlockValid(set_num, idx)) index.erase(tag);
+        if(block.valid_bit) index.insert(block.tag, idx);
     }
-    // std::cout << "set " << set_num << " :e " << incoming_cache_block.tag << endl;
-    incoming_cache_block.lru_counter = 0;
-    cache[set_num][lru_idx] = incoming_cache_block;
-    // std::cout << "While replace: set " << hex << set_num << " " << hex << incoming_cache_block.tag << " lru_idx: " << dec << lru_idx<< endl;
-    // printCacheSet(set_num);
-    // std::cout << "While replace counters:";
-    // for(int i = 0; i < assoc; i++)
-    // {
-    //     std::cout << cache[set_num][i].lru_counter << " ";
-    // }
-    // std::cout << endl;
-    return lruCacheBlock;
+
+    tag = block.tag;
+    setBit(getValidBits(set_num), idx, block.valid_bit);
+    setBit(getDirtyBits(set_num), idx, block.dirty_bit);
+}
+
+
+void Cache::clearValid(int set_num, int idx)
+{
+    if(isTagIndexed && isBlockValid(set_num, idx)) getTagIndex(set_num).erase(getSetTags(set_num)[idx]);
+    setBit(getValidBits(set_num), idx, false);
 }
 
 // CacheBlock Cache::evictBlock(int set_num, int lru_idx)
@@ -566,31 +404,27 @@ CacheBlock Cache::evictAndReplaceBlock(CacheBlock incoming_cache_block, int set_
 
 void Cache::printCacheContents()
 {
-    // For printing, mru -> lru blocks, we need to sort based on lru_counters
-    // Comparator for sorting
-    auto sorting_comparator = [] (CacheBlock a, CacheBlock b)
+    // For printing, mru -> lru blocks (LRU), the order of the replacement policy otherwise
+    for(uint i = 0; i < n_sets; i++)
     {
-        if(a.lru_counter < b.lru_counter)
-        {
-            return true;
-        }
-        else
+        std::cout << "  set " << dec << i << ":\t";
+
+        // A set never touched holds invalid blocks only
+        if(!sets.isTouched(i))
         {
-            return false;
+            for(uint way = 0; way < assoc; way++) std::cout << hex << 0 << "  \t";
+            std::cout << endl;
+            continue;
         }
-    };
 
-    for(int i = 0; i < n_sets; i++)
-    {
-        std::cout << "  set " << dec << i << ":\t";
-
-        // Sort cache_blocks cooresponding to set i
-        vector<CacheBlock> cache_blocks = cache[i];
-        sort(cache_blocks.begin(), cache_blocks.end(), sorting_comparator);
+        vector<int> order = visit([i] (auto& policy) {return policy.getOrder(i);}, replacement);
+        vector<CacheBlock> cache_blocks;
+        for(int way : order) cache_blocks.push_back(readBlock(i, way));
 
         for(auto cb: cache_blocks)
         {
-            std::cout << hex << cb.tag ;
+            // An invalid way (back-invalidated, handed to another level) prints like the ways of an untouched set
+            std::cout << hex << (cb.valid_bit ? cb.tag : 0);
 
             if(cb.dirty_bit == true)
                 std::cout << " D\t";
@@ -601,7 +435,90 @@ void Cache::printCacheContents()
     }
 }
 
+void Cache::enablePCStatistics()
+{
+    isPCStatsEnabled = true;
+    if(isVCEnabled) vc_cache->enablePCStatistics();
+}
+
+
+void Cache::setWarming(bool isWarming)
+{
+    this->isWarming = isWarming;
+    if(isVCEnabled) vc_cache->setWarming(isWarming);
+}
+
+
 void Cache::unsetDirty(int set_num, int idx)
 {
-    cache[set_num][idx].dirty_bit = false;
+    setBit(getDirtyBits(set_num), idx, false);
+}
+
+
+int Cache::findWay(int set_num, long long int tag)
+{
+    if(isTagIndexed) return getTagIndex(set_num).find(tag);
+    const uint64_t* set_tags = getSetTags(set_num);
+    return findMatchingWay(set_tags, set_tags + tag_stride, tag_stride, tag);
+}
+
+
+CacheBlock Cache::invalidateAddress(long long int addr)
+{
+    int set_num = getSetNumber(addr);
+    int idx = findWay(set_num, getTag(addr));
+    if(idx != -1)
+    {
+        CacheBlock block = readBlock(set_num, idx);
+        invalidateBlock(set_num, idx);
+        return block;
+    }
+    if(isVCEnabled) return vc_cache->invalidateAddress(addr);
+    return CacheBlock();
+}
+
+
+void Cache::setDirty(long long int addr)
+{
+    int set_num = getSetNumber(addr);
+    int idx = findWay(set_num, getTag(addr));
+    if(idx != -1)
+        writeData(set_num, idx);
+    else if(isVCEnabled)
+        vc_cache->setDirty(addr);
+}
+
+
+void Cache::invalidateBlock(int set_num, int idx)
+{
+    CacheBlock block = readBlock(set_num, idx);
+    block.valid_bit = false;
+    block.dirty_bit = false;
+    storeBlock(set_num, idx, block);
+    visit([set_num, idx] (auto& policy) {policy.onInvalidate(set_num, idx);}, replacement);
+}
+
+
+CacheBlock Cache::backInvalidate(long long int addr)
+{
+    CacheBlock block = invalidateAddress(addr);
+    if(block.valid_bit && !isWarming) c_stats.n_back_invalidations++;
+    return block;
+}
+
+
+void Cache::copySet(const Cache& other, int set_num)
+{
+    sets.copySet(other.sets, set_num);
+    if(isTagIndexed) tag_indexes.copySet(other.tag_indexes, set_num);
+    visit([&other, set_num] (auto& policy)
+    {
+        policy.copySet(get<decay_t<decltype(policy)>>(other.replacement), set_num);
+    }, replacement);
+}
+
+
+void Cache::addPCMisses(const unordered_map<uint64_t, uint>& other_pc_misses)
+{
+    for(auto& pc_miss : other_pc_misses) pc_misses[pc_miss.first] += pc_miss.second;
 }
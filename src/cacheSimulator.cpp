@@ -1,6 +1,9 @@
 #include "cacheSimulator.h"
+#include "threadPool.h"
 #include<iomanip>
 #include<cmath>
+#include<algorithm>
+#include<climits>
 
 // RAW STATISTICS
 void RawStatistics::printStats()
@@ -17,13 +20,42 @@ void RawStatistics::printStats()
     cout << "  g. number of swaps:\t\t" << n_swaps << endl;
     cout << "  h. combined L1+VC miss rate:\t\t" << l1_vc_miss_rate << endl;
     cout << "  i. number writebacks from L1/VC:\t\t" << l1_writebacks << endl;
-    cout << "  j. number of L2 reads:\t\t" << l2_reads << endl;
-    cout << "  k. number of L2 read misses:\t\t" << l2_read_misses << endl;
-    cout << "  l. number of L2 writes:\t\t" << l2_writes << endl;
-    cout << "  m. number of L2 write misses:\t\t" << l2_write_misses << endl;
-    cout << "  n. L2 miss rate:\t\t" << l2_miss_rate << endl;
-    cout << "  o. number of writebacks from L2:\t\t" << l2_writebacks << endl;
+    LevelRawStatistics l2 = getLowerLevel(0);
+    cout << "  j. number of L2 reads:\t\t" << l2.reads << endl;
+    cout << "  k. number of L2 read misses:\t\t" << l2.read_misses << endl;
+    cout << "  l. number of L2 writes:\t\t" << l2.writes << endl;
+    cout << "  m. number of L2 write misses:\t\t" << l2.write_misses << endl;
+    cout << "  n. L2 miss rate:\t\t" << l2.miss_rate << endl;
+    cout << "  o. number of writebacks from L2:\t\t" << l2.writebacks << endl;
+
+    // Levels below L2 follow the same lines, without letters
+    for(size_t i = 1; i < lower_levels.size(); i++)
+    {
+        const LevelRawStatistics& level = lower_levels[i];
+        string name = "L" + to_string(i + 2);
+        cout << "     number of " << name << " reads:\t\t" << level.reads << endl;
+        cout << "     number of " << name << " read misses:\t\t" << level.read_misses << endl;
+        cout << "     number of " << name << " writes:\t\t" << level.writes << endl;
+        cout << "     number of " << name << " write misses:\t\t" << level.write_misses << endl;
+        cout << "     " << name << " miss rate:\t\t" << level.miss_rate << endl;
+        cout << "     number of writebacks from " << name << ":\t\t" << level.writebacks << endl;
+    }
     cout << "  p. total memory traffic:\t\t" << total_memory_traffic << endl;
+
+    if(n_split_accesses > 0)
+    {
+        cout << "  q. number of block-crossing accesses:\t\t" << n_split_accesses << endl;
+        cout << "  r. number of extra block requests:\t\t" << n_split_requests << endl;
+    }
+
+    if(inclusion == InclusionPolicy::INCLUSIVE)
+    {
+        cout << "  back-invalidations in L1/VC:\t\t" << l1_back_invalidations << endl;
+        for(size_t i = 0; i + 1 < lower_levels.size(); i++)
+        {
+            cout << "  back-invalidations in L" << i + 2 << ":\t\t" << lower_levels[i].back_invalidations << endl;
+        }
+    }
 }
 
 
@@ -39,13 +71,37 @@ void PerformanceStatistics::printStats()
 }
 
 
+bool parseInclusionPolicy(const string& name, InclusionPolicy& inclusion)
+{
+    if(name == "nine") inclusion = InclusionPolicy::NINE;
+    else if(name == "inclusive") inclusion = InclusionPolicy::INCLUSIVE;
+    else if(name == "exclusive") inclusion = InclusionPolicy::EXCLUSIVE;
+    else return false;
+    return true;
+}
+
+
+const char* getInclusionPolicyName(InclusionPolicy inclusion)
+{
+    switch(inclusion)
+    {
+        case InclusionPolicy::NINE: return "nine";
+        case InclusionPolicy::INCLUSIVE: return "inclusive";
+        case InclusionPolicy::EXCLUSIVE: return "exclusive";
+    }
+    return "";
+}
+
+
 /****************************
 ****** CACHE SIMULATOR ******
 ****************************/
  
 CacheSimulator::CacheSimulator(uint l1_size, uint l1_assoc, uint l1_blocksize,
                    uint n_vc_blocks,
-                   uint l2_size, uint l2_assoc, string trace_file_name)
+                   uint l2_size, uint l2_assoc, string trace_file_name,
+                   ReplacementPolicyKind policy_kind, InclusionPolicy inclusion,
+                   const vector<LevelGeometry>& deeper_levels)
 {
     this->l1_size = l1_size;
     this->l1_assoc = l1_assoc;
@@ -54,190 +110,216 @@ CacheSimulator::CacheSimulator(uint l1_size, uint l1_assoc, uint l1_blocksize,
     this->l2_size = l2_size;
     this->l2_assoc = l2_assoc;
     this->trace_file_name = trace_file_name;
-
-    l1_cache = Cache(l1_size, l1_assoc, l1_blocksize, n_vc_blocks);
+    this->policy_kind = policy_kind;
+    this->inclusion = inclusion;
+    n_split_accesses = 0;
+    n_split_requests = 0;
+    isSetSamplingEnabled = false;
+    isL1Replayed = false;
+    isSetPartitioned = false;
+    n_set_groups = 1;
+    n_partitions = 1;
+    partition = 0;
+    n_blockOffsetBits = log2(l1_blocksize);
+    isPCStatsEnabled = false;
+    prefetch_distance = REQUEST_PREFETCH_DISTANCE;
+
+    // Every level uses the L1 block size
+    arena = make_unique<MetadataArena>();
+    levels.reserve(2 + deeper_levels.size());
+    levels.emplace_back(arena.get(), l1_size, l1_assoc, l1_blocksize, n_vc_blocks, policy_kind);
     isVCEnabled = (n_vc_blocks > 0) ? true : false;
 
-    // cout << "L2 size " << l2_size << endl;
-    if(l2_size == 0)
+    isL2Exist = l2_size > 0;
+    if(isL2Exist)
     {
-        isL2Exist = false;
-        l2_cache = Cache();
-    }
-    else{
-        isL2Exist = true;
-        l2_cache = Cache(l2_size, l2_assoc, l1_blocksize, 0);
+        levels.emplace_back(arena.get(), l2_size, l2_assoc, l1_blocksize, 0, policy_kind);
+        this->deeper_levels = deeper_levels;
+        for(const LevelGeometry& geometry : deeper_levels)
+        {
+            levels.emplace_back(arena.get(), geometry.size, geometry.assoc, l1_blocksize, 0, policy_kind);
+        }
     }
+    arena->map();
+
+    isL1Prefetched = levels[0].getSetTableBytes() >= REQUEST_PREFETCH_MIN_BYTES;
+    isL2Prefetched = isL2Exist && levels[1].getSetTableBytes() >= REQUEST_PREFETCH_MIN_BYTES;
+
+    selectRequestKernel();
 }
 
 
-// void CacheSimulator::sendRequests(vector<TraceEntry> trace_contents)
-// {
-//     for(auto traceEntry : trace_contents)
-//     {
-//         if(traceEntry.operation == "r")
-//             sendReadRequest(traceEntry.addr);
-//         else
-//             sendWriteRequest(traceEntry.addr);
-//     }
-// }
+void CacheSimulator::selectRequestKernel()
+{
+    request_kernel = &CacheSimulator::sendRequestsWith<GenericCacheKernel>;
+    warm_kernel = &CacheSimulator::warmRequestsWith<GenericCacheKernel>;
+
+#define SELECT_CACHE_KERNEL(assoc, block_size) \
+    if(l1_assoc == assoc && l1_blocksize == block_size) \
+    { \
+        request_kernel = &CacheSimulator::sendRequestsWith<CacheKernel<assoc, block_size>>; \
+        warm_kernel = &CacheSimulator::warmRequestsWith<CacheKernel<assoc, block_size>>; \
+    }
+    CACHE_KERNEL_GRID(SELECT_CACHE_KERNEL)
+#undef SELECT_CACHE_KERNEL
+}
 
 
-void CacheSimulator::sendReadRequest(long long int addr)
+void CacheSimulator::sendRequests(const TraceEntry* entries, size_t n_entries)
 {
-    /*
-        Four configurations are investigated in this project:
-        1. L1 + Memory
-        2. L1 + L2 + Memory
-        3. (L1 + VC) + Memory
-        4. (L1 + VC) + L2 + Memory
+    (this->*request_kernel)(entries, n_entries);
+}
 
-        Cache::lookupRead function considers (L1+VC) configuration results combinedly
-    */
-    // cout << "Cache Read: " << hex << addr << dec << endl;
-    auto l1_read_result = l1_cache.lookupRead(addr);
-    int l1_set_num = l1_cache.getSetNumber(addr);
 
-    // cout << addr << " r: " << l1_cache.getSetNumber(addr) << " " << l1_cache.getTag(addr) << endl;
+template<typename L1Kernel>
+void CacheSimulator::sendRequestsWith(const TraceEntry* entries, size_t n_entries)
+{
+    uint64_t l1_blocksize = 1ULL << L1Kernel::getBlockOffsetBits(n_blockOffsetBits);
+    uint64_t block_offset_mask = l1_blocksize - 1;
 
-    if(l1_read_result.first == true)    // L1 hit   (i.e L1+VC hit if VC is enabled)
+    // The first accesses of the batch are prefetched up front, then one access `distance` ahead per access
+    bool isPrefetched = (isL1Prefetched || isL2Prefetched) && arena->getUsedBytes() >= REQUEST_PREFETCH_MIN_BYTES;
+    size_t distance = isPrefetched ? prefetch_distance : 0;
+    if(distance > 0)
     {
-        // No need to pass down to further levels of memory
-        // l1_cache.readData(l1_set_num, l1_read_result.second.first);
+        for(size_t i = 0; i < min(distance, n_entries); i++) prefetchRequest<L1Kernel>(entries[i].addr);
     }
-    else    // L1 miss
+
+    for(size_t i = 0; i < n_entries; i++)
     {
-        if(isL2Exist)   // L1+L2 config or (L1+VC)+ L2 config
-        {
-            auto l2_read_result = l2_cache.lookupRead(addr);
-            int l2_set_num = l2_cache.getSetNumber(addr);
+        const TraceEntry& entry = entries[i];
+        uint64_t addr = entry.addr;
+        if(distance > 0 && i + distance < n_entries) prefetchRequest<L1Kernel>(entries[i + distance].addr);
 
-            if(l2_read_result.first == true) // L2 hit
-            {
-                // pass the value back to L1
-                CacheBlock l2_block = l2_cache.getBlock(l2_set_num, l2_read_result.second.first);
-                l2_block.tag = l1_cache.getTag(l2_cache.getBlockAddress(l2_set_num, l2_block.tag));
-                // l2_cache.unsetDirty(l2_set_num, l2_read_result.second.first);
-                l2_block.dirty_bit = false;
-
-                CacheBlock evictedBlock;
-                long long int evictedBlock_addr;
-
-                if(l1_read_result.second.first == -1)   // eviction done from vc of L1
-                {
-                    evictedBlock = l1_read_result.second.second;
-                    evictedBlock_addr = l1_cache.vc_cache->getBlockAddress(0, evictedBlock.tag);
-                    l1_cache.evictAndReplaceBlock(l2_block, l1_set_num, -1);
-                }
-                else
-                {
-                    evictedBlock = l1_cache.evictAndReplaceBlock(l2_block, l1_set_num, l1_read_result.second.first);
-                    evictedBlock_addr = l1_cache.getBlockAddress(l1_set_num, evictedBlock.tag);
-                }
-                
-
-                // if evictedBlock from L1 is dirty, need to write to L2
-                if(evictedBlock.valid_bit == true && evictedBlock.dirty_bit == true)
-                {
-                    evictedBlock.tag = l2_cache.getTag(evictedBlock_addr);
-                    auto l1_writeback_result = l2_cache.lookupWrite(evictedBlock_addr);
-
-                    if(l1_writeback_result.first == true)
-                    {
-                        l2_cache.writeData(l2_cache.getSetNumber(evictedBlock_addr), l1_writeback_result.second.first);
-                    }
-                    else
-                    {
-                        CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(evictedBlock, l2_cache.getSetNumber(evictedBlock_addr), l1_writeback_result.second.first);
-                        l2_cache.writeData(l2_cache.getSetNumber(evictedBlock_addr), l1_writeback_result.second.first);
-                        
-                        // If L2 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-                        // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                    }
-                }
-            }
-            else    // L2 miss
-            {
-                CacheBlock l1_newBlock = CacheBlock(l1_cache.getTag(addr));
-                CacheBlock l2_newBlock = CacheBlock(l2_cache.getTag(addr));
-                
-                CacheBlock l1_evictedBlock;
-                long long int l1_evictedBlock_addr;
-
-                if(l1_read_result.second.first == -1)   // eviction done from vc of L1
-                {
-                    l1_evictedBlock = l1_read_result.second.second;
-                    l1_evictedBlock_addr = l1_cache.vc_cache->getBlockAddress(0, l1_evictedBlock.tag);
-                    l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, -1);
-                }
-                else
-                {
-                    l1_evictedBlock = l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, l1_read_result.second.first);
-                    l1_evictedBlock_addr = l1_cache.getBlockAddress(l1_set_num, l1_evictedBlock.tag);
-                }
-                
-
-                if(l1_evictedBlock.valid_bit == true && l1_evictedBlock.dirty_bit == true)
-                {
-                    l1_evictedBlock.tag = l2_cache.getTag(l1_evictedBlock_addr);
-                    auto l1_writeback_result = l2_cache.lookupWrite(l1_evictedBlock_addr);
-
-                    if(l1_writeback_result.first == true)
-                    {
-                        l2_cache.writeData(l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second.first);
-                        CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                        // If L2 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-                        // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                    }
-                    else
-                    {
-                        CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l1_evictedBlock, l2_cache.getSetNumber(l1_evictedBlock_addr), -1);
-                        CacheBlock l2_second_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                          
-
-                        // CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l1_evictedBlock, l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second);
-                        // l2_cache.writeData(l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second);                        
-
-                        // CacheBlock l2_second_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                        // // If L2 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-                        // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                        // if(l2_second_evictedBlock.valid_bit == true && l2_second_evictedBlock.dirty_bit == true) cout << "L2 Writeback second" << endl;
-                    }
-                }
-                else
-                {
-                    CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, l2_read_result.second.first);
-                    // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                }
-                // If L2 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-            }
+        if(entry.size <= 1 || (addr & block_offset_mask) + entry.size <= l1_blocksize)    // within one block
+        {
+            if(entry.operation == 'r')
+                sendRequest<AccessType::READ, L1Kernel>(entry.addr, entry.pc);
+            else
+                sendRequest<AccessType::WRITE, L1Kernel>(entry.addr, entry.pc);
+            continue;
         }
-        else    // L1 config or (L1+VC) config
+
+        // Block-crossing access: the first request keeps the address, the rest start at their block
+        uint64_t last_addr = addr + entry.size - 1;
+        n_split_accesses++;
+
+        for(uint64_t block_addr = addr; ; block_addr = (block_addr & ~block_offset_mask) + l1_blocksize)
         {
-            CacheBlock l1_newBlock = CacheBlock(l1_cache.getTag(addr));
+            if(entry.operation == 'r')
+                sendRequest<AccessType::READ, L1Kernel>(block_addr, entry.pc);
+            else
+                sendRequest<AccessType::WRITE, L1Kernel>(block_addr, entry.pc);
 
-            CacheBlock l1_evictedBlock;
-            if(l1_read_result.second.first == -1)
-            {
-                l1_evictedBlock = l1_read_result.second.second;
-                l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, -1);
-            }
+            if((block_addr & ~block_offset_mask) == (last_addr & ~block_offset_mask)) break;
+            n_split_requests++;
+        }
+    }
+}
+
+
+void CacheSimulator::warmRequests(const TraceEntry* entries, size_t n_entries)
+{
+    (this->*warm_kernel)(entries, n_entries);
+}
+
+
+template<typename L1Kernel>
+void CacheSimulator::warmRequestsWith(const TraceEntry* entries, size_t n_entries)
+{
+    uint64_t l1_blocksize = 1ULL << L1Kernel::getBlockOffsetBits(n_blockOffsetBits);
+    uint64_t block_offset_mask = l1_blocksize - 1;
+
+    for(Cache& cache : levels) cache.setWarming(true);
+    for(size_t i = 0; i < n_entries; i++)
+    {
+        const TraceEntry& entry = entries[i];
+        uint64_t addr = entry.addr;
+        uint64_t last_addr = (entry.size <= 1) ? addr : addr + entry.size - 1;
+
+        // Every block of a block-crossing access is warmed, the split counts are left alone
+        for(uint64_t block_addr = addr; ; block_addr = (block_addr & ~block_offset_mask) + l1_blocksize)
+        {
+            if(entry.operation == 'r')
+                warmRequest<AccessType::READ, L1Kernel>(block_addr);
             else
+                warmRequest<AccessType::WRITE, L1Kernel>(block_addr);
+
+            if((block_addr & ~block_offset_mask) == (last_addr & ~block_offset_mask)) break;
+        }
+    }
+    for(Cache& cache : levels) cache.setWarming(false);
+}
+
+
+template<AccessType TYPE, typename L1Kernel>
+void CacheSimulator::warmRequest(long long int addr)
+{
+    // No PC (no per-PC misses), no filter trace record, no sampling bookkeeping: only the blocks move
+    Cache& l1_cache = levels[0];
+    AccessResult l1_result = l1_cache.access<TYPE, L1Kernel>(addr);
+    if(l1_result.isHit) return;
+
+    EvictedBlock l1_evicted = l1_cache.fill<L1Kernel>(l1_result, TYPE == AccessType::WRITE);
+    if(isL2Exist)
+    {
+        bool hasVictim = (inclusion == InclusionPolicy::EXCLUSIVE) ? l1_evicted.isValid : l1_evicted.isDirty;
+        bool isDirtyBelow = fetchFromLevel(1, addr, 0, hasVictim, l1_evicted.addr, l1_evicted.isDirty);
+        if(isDirtyBelow) l1_cache.setDirty(addr);
+    }
+}
+
+
+void CacheSimulator::sendRequestsSetPartitioned(const TraceEntry* entries, size_t n_entries, uint n_threads)
+{
+    uint n_shards = min(n_threads, findSetGroupCount());
+    if(isVCEnabled || isSetSamplingEnabled || filter_trace_writer || !level_pipelines.empty() || n_shards < 2)
+    {
+        sendRequests(entries, n_entries);
+        return;
+    }
+
+    // Every shard starts from the current contents of its sets and from zero counters
+    vector<unique_ptr<CacheSimulator>> shards;
+    for(uint p = 0; p < n_shards; p++)
+    {
+        CacheSimulator* shard = new CacheSimulator(l1_size, l1_assoc, l1_blocksize, n_vc_blocks, l2_size, l2_assoc, trace_file_name,
+                                                    policy_kind, inclusion, deeper_levels);
+        shard->isSetPartitioned = true;
+        shard->n_set_groups = findSetGroupCount();
+        shard->n_partitions = n_shards;
+        shard->partition = p;
+        shard->prefetch_distance = prefetch_distance;
+        if(isPCStatsEnabled) shard->enablePCStatistics();
+
+        for(size_t level = 0; level < levels.size(); level++)
+        {
+            for(uint set = 0; set < levels[level].getSetCount(); set++)
             {
-                l1_evictedBlock = l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, l1_read_result.second.first);
+                if(shard->isSetInPartition(set)) shard->levels[level].copySet(levels[level], set);
             }
-            // cout << "set " << l1_set_num << " :n1 " << l1_cache.getBlock(l1_set_num, l1_read_result.second).tag << " " << l1_cache.getBlock(l1_set_num, l1_read_result.second).valid_bit << endl;
-            // cout << "set " << l1_set_num << " :n2 " << l1_cache.getBlock(l1_set_num, l1_read_result.second).tag <<  " " << l1_cache.getBlock(l1_set_num, l1_read_result.second).valid_bit << endl;
-            // cout << endl;
-            // l1_cache.readData(l1_set_num, l1_read_result.second.first);
-            
-            // If L1 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
         }
+        shards.emplace_back(shard);
     }
+
+    ThreadPool pool(n_shards);
+    for(auto& shard : shards)
+    {
+        CacheSimulator* shard_sim = shard.get();
+        pool.submit([shard_sim, entries, n_entries] () {shard_sim->sendRequests(entries, n_entries);});
+    }
+    pool.waitAll();
+
+    for(auto& shard : shards) mergeSetPartition(*shard);
+
+    // Every shard sees every access: the split counts are those of any one of them
+    n_split_accesses += shards[0]->n_split_accesses;
+    n_split_requests += shards[0]->n_split_requests;
 }
 
 
-void CacheSimulator::sendWriteRequest(long long int addr)
+template<AccessType TYPE, typename L1Kernel>
+void CacheSimulator::sendRequest(long long int addr, uint64_t pc)
 {
     /*
         Four configurations are investigated in this project:
@@ -246,161 +328,157 @@ void CacheSimulator::sendWriteRequest(long long int addr)
         3. (L1 + VC) + Memory
         4. (L1 + VC) + L2 + Memory
 
-        Cache::lookupWrite function considers (L1+VC) configuration results combinedly
+        Cache::access function considers (L1+VC) configuration results combinedly
     */
-    // cout << "Cache Write: " << hex << addr << dec << endl;
-    auto l1_write_result = l1_cache.lookupWrite(addr);
-    int l1_set_num = l1_cache.getSetNumber(addr);
+    if(isSetSamplingEnabled && !set_sampler.isSampled(addr)) return;
+    if(isSetPartitioned && !isInPartition(addr)) return;
 
-    // cout << addr << " : " << l1_cache.getSetNumber(addr) << " " << l1_cache.getTag(addr) << endl;
+    AccessResult l1_result = levels[0].access<TYPE, L1Kernel>(addr, pc);
 
-    if(l1_write_result.first == true)    // L1 hit   (i.e L1+VC hit if VC is enabled)
+    // L1 hit (i.e L1+VC hit if VC is enabled): no need to pass down to further levels of memory
+    if(l1_result.isHit == false) allocateL1Block<L1Kernel>(addr, pc, l1_result, TYPE == AccessType::WRITE);
+
+    if(isSetSamplingEnabled) recordSampledAccess(addr);
+}
+
+
+template<typename L1Kernel>
+void CacheSimulator::allocateL1Block(long long int addr, uint64_t pc, const AccessResult& l1_result, bool isWrite)
+{
+    // The new L1 block is placed before the next level is asked (NINE / inclusive: L1 does not depend on it)
+    Cache& l1_cache = levels[0];
+    EvictedBlock l1_evicted = l1_cache.fill<L1Kernel>(l1_result, isWrite);
+
+    // If the L1 (or VC) eviction is dirty, it is written back to the next level
+    bool hasWriteback = l1_evicted.isDirty;
+
+    if(filter_trace_writer) filter_trace_writer->write(addr, hasWriteback, l1_evicted.addr);
+    if(isLevelThreaded(1))
     {
-        // No need to pass down to further levels of memory
-        l1_cache.writeData(l1_set_num, l1_write_result.second.first);
+        forwardFetch(1, addr, pc, hasWriteback, l1_evicted.addr);
     }
-    else    // L1 miss
+    else if(isL2Exist)
     {
-        if(isL2Exist)   // L1+L2 config or (L1+VC)+ L2 config
-        {
-            auto l2_read_result = l2_cache.lookupRead(addr);
-            int l2_set_num = l2_cache.getSetNumber(addr);
+        // NINE / inclusive levels take the dirty victims (writebacks), exclusive ones every victim
+        bool hasVictim = (inclusion == InclusionPolicy::EXCLUSIVE) ? l1_evicted.isValid : hasWriteback;
+        bool isDirtyBelow = fetchFromLevel(1, addr, pc, hasVictim, l1_evicted.addr, l1_evicted.isDirty);
+        if(isDirtyBelow) l1_cache.setDirty(addr);
+    }
+    // Without L2, misses and writebacks go to memory, as of now for simulation, we are not doing anything
+}
 
-            if(l2_read_result.first == true) // L2 hit
-            {
-                // pass the value back to L1
-                CacheBlock l2_block = l2_cache.getBlock(l2_set_num, l2_read_result.second.first);
-                long long int l2_block_addr = l2_cache.getBlockAddress(l2_set_num, l2_block.tag);
-                // cout << "L2->L1 : " << hex << l2_block.tag;
-
-                l2_block.tag = l1_cache.getTag(l2_block_addr);
-                // cout << " | L2 addr: " << hex << l2_block_addr << " | L1 tag"  << hex << l2_block.tag << endl;
-
-                // l2_cache.unsetDirty(l2_set_num, l2_read_result.second.first);
-
-                CacheBlock evictedBlock;
-                long long int evictedBlock_addr;
-
-                if(l1_write_result.second.first == -1)   // eviction done from vc of L1
-                {
-                    evictedBlock = l1_write_result.second.second;
-                    evictedBlock_addr = l1_cache.vc_cache->getBlockAddress(0, evictedBlock.tag);
-                    
-                    // cout << "VC->L2 : " << hex << evictedBlock.tag << " | VC addr: " << hex << evictedBlock_addr << " | L2 tag " << l2_cache.getTag(evictedBlock_addr) << endl;
-                    l2_block.dirty_bit = true;
-                    l1_cache.evictAndReplaceBlock(l2_block, l1_set_num, -1);
-                }
-                else
-                {
-                    evictedBlock = l1_cache.evictAndReplaceBlock(l2_block, l1_set_num, l1_write_result.second.first);
-                    evictedBlock_addr = l1_cache.getBlockAddress(l1_set_num, evictedBlock.tag);
-                    l1_cache.writeData(l1_set_num, l1_write_result.second.first);
-                }
-
-
-                // if evictedBlock from L1 is dirty, need to write to L2
-                if(evictedBlock.valid_bit == true && evictedBlock.dirty_bit == true)
-                {
-                    auto l1_writeback_result = l2_cache.lookupWrite(evictedBlock_addr);
-                    evictedBlock.tag = l2_cache.getTag(evictedBlock_addr);
-
-                    if(l1_writeback_result.first == true)
-                    {
-                        l2_cache.writeData(l2_cache.getSetNumber(evictedBlock_addr), l1_writeback_result.second.first);
-                    }
-                    else
-                    {
-                        CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(evictedBlock, l2_cache.getSetNumber(evictedBlock_addr), -1);
-                        l2_cache.writeData(l2_cache.getSetNumber(evictedBlock_addr), l1_writeback_result.second.first);
-                        
-                        // If L2 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-                        // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                    }
-                }
-            }
-            else    // L2 miss
-            {
-                CacheBlock l1_newBlock = CacheBlock(l1_cache.getTag(addr));
-                CacheBlock l2_newBlock = CacheBlock(l2_cache.getTag(addr));
 
-                CacheBlock l1_evictedBlock;
-                long long int l1_evictedBlock_addr;
+// Generic requests of the public interface (sendRequests runs the kernel picked for L1)
+template void CacheSimulator::sendRequest<AccessType::READ, GenericCacheKernel>(long long int addr, uint64_t pc);
+template void CacheSimulator::sendRequest<AccessType::WRITE, GenericCacheKernel>(long long int addr, uint64_t pc);
 
-                if(l1_write_result.second.first == -1)   // eviction done from vc of L1
-                {
-                    l1_evictedBlock = l1_write_result.second.second;
-                    l1_evictedBlock_addr = l1_cache.vc_cache->getBlockAddress(0, l1_evictedBlock.tag);
-                    // cout << "VC->L2 : " << hex << l1_evictedBlock.tag << " | VC addr: " << hex << l1_evictedBlock_addr << " | L2 tag " << l2_cache.getTag(l1_evictedBlock_addr) << endl;
 
-                    l1_newBlock.dirty_bit = true;
-                    l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, -1);
-                }
-                else
-                {
-                    l1_evictedBlock = l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, l1_write_result.second.first);
-                    l1_evictedBlock_addr = l1_cache.getBlockAddress(l1_set_num, l1_evictedBlock.tag);
-                    // cout << "L1->L2 : " << hex << l1_evictedBlock.tag << " | L1 addr: " << hex << l1_evictedBlock_addr << " | L2 tag " << l2_cache.getTag(l1_evictedBlock_addr) << endl;
-
-                    l1_cache.writeData(l1_set_num, l1_write_result.second.first);
-                }
-                
-                if(l1_evictedBlock.valid_bit == true && l1_evictedBlock.dirty_bit == true)
-                {
-                    // long long int l1_evictedBlock_addr = l1_cache.getBlockAddress(l1_set_num, l1_evictedBlock.tag);
-                    auto l1_writeback_result = l2_cache.lookupWrite(l1_evictedBlock_addr);
-
-                    if(l1_writeback_result.first == true)
-                    {
-                        // l2_cache.writeData(l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second);
-                        // CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                        // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                        l2_cache.writeData(l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second.first);
-                        CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                    }
-                    else
-                    {
-                        l1_evictedBlock.tag = l2_cache.getTag(l1_evictedBlock_addr);
-                        // CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l1_evictedBlock, l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second);
-                        // l2_cache.writeData(l2_cache.getSetNumber(l1_evictedBlock_addr), l1_writeback_result.second);
-                        
-                        // CacheBlock l2_second_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                        // // If L2 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-                        // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                        // if(l2_second_evictedBlock.valid_bit == true && l2_second_evictedBlock.dirty_bit == true) cout << "L2 Writeback second" << endl;
-                        CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l1_evictedBlock, l2_cache.getSetNumber(l1_evictedBlock_addr), -1);
-                        CacheBlock l2_second_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, -1);
-                    }
-                }
-                else
-                {
-                    CacheBlock l2_evictedBlock = l2_cache.evictAndReplaceBlock(l2_newBlock, l2_set_num, l2_read_result.second.first);
-                    // if(l2_evictedBlock.valid_bit == true && l2_evictedBlock.dirty_bit == true) cout << "L2 Writeback" << endl;
-                }
-            }
-        }
-        else    // L1 config or (L1+VC) config
+bool CacheSimulator::fetchFromLevel(uint level, long long int addr, uint64_t pc, bool hasVictim, long long int victim_addr, bool isVictimDirty)
+{
+    // A level is read for read and write misses of the level above alike (the block is fetched, the level above
+    // holds the written data)
+    Cache& cache = levels[level];
+    bool isLastLevel = level + 1 == levels.size();
+    AccessResult result = cache.access<AccessType::READ>(addr, pc);
+
+    if(inclusion == InclusionPolicy::EXCLUSIVE)
+    {
+        // A hit hands the block to the level above, a miss is not filled here
+        bool isDirty = false;
+        if(result.isHit)
         {
-            CacheBlock l1_newBlock = CacheBlock(l1_cache.getTag(addr));
+            isDirty = cache.isBlockDirty(result.set_num, result.idx);
+            cache.invalidateBlock(result.set_num, result.idx);
+        }
+        if(hasVictim) insertVictim(level, victim_addr, isVictimDirty);
+        if(result.isHit == false && !isLastLevel) isDirty = fetchFromLevel(level + 1, addr, pc, false, 0, false);
+        return isDirty;
+    }
 
-            CacheBlock l1_evictedBlock;
-            if(l1_write_result.second.first == -1)
-            {
-                l1_evictedBlock = l1_write_result.second.second;
-                l1_newBlock.dirty_bit = true;
-                l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, -1);
-            }
-            else
-            {
-                l1_evictedBlock = l1_cache.evictAndReplaceBlock(l1_newBlock, l1_set_num, l1_write_result.second.first);
-                l1_cache.writeData(l1_set_num, l1_write_result.second.first);
-            }
+    if(result.isHit)
+    {
+        if(hasVictim) writeBackToLevel(level, victim_addr);
+        return false;
+    }
 
-            
-            // cout << "After replace: " << dec << l1_write_result.second << endl;
-            // l1_cache.printCacheSet(l1_set_num);
-            // cout << "\n" << endl;
-            // If L1 eviction is also dirty then write to memory, as of now for simulation, we are not doing anything
-        }
+    // Miss: the writeback is placed before the demanded block
+    int fill_idx = result.idx;
+    if(hasVictim)
+    {
+        writeBackToLevel(level, victim_addr);
+        fill_idx = -1;
+    }
+    EvictedBlock evicted = cache.fillBlock(result.set_num, fill_idx, result.tag, false);
+
+    // The next level is asked for the block, with the dirty victim as its writeback. The last level's misses and
+    // writebacks go to memory, as of now for simulation, we are not doing anything
+    bool hasWriteback = evicted.isValid && releaseBlock(level, evicted.addr, evicted.isDirty);
+    if(!isLastLevel) forwardFetch(level + 1, addr, pc, hasWriteback, evicted.addr);
+    return false;
+}
+
+
+void CacheSimulator::writeBackToLevel(uint level, long long int addr)
+{
+    // A hit dirties the block in place, a miss allocates it dirty
+    Cache& cache = levels[level];
+    AccessResult result = cache.access<AccessType::WRITE>(addr);
+    if(result.isHit) return;
+
+    EvictedBlock evicted = cache.fill(result, true);
+    if(evicted.isValid == false) return;
+
+    if(releaseBlock(level, evicted.addr, evicted.isDirty) && level + 1 < levels.size())
+    {
+        forwardWriteback(level + 1, evicted.addr);
+    }
+}
+
+
+void CacheSimulator::forwardFetch(uint level, long long int addr, uint64_t pc, bool hasWriteback, long long int writeback_addr)
+{
+    if(isLevelThreaded(level))
+        level_pipelines[level]->push({false, {addr, pc, hasWriteback, writeback_addr}});
+    else
+        fetchFromLevel(level, addr, pc, hasWriteback, writeback_addr, true);
+}
+
+
+void CacheSimulator::forwardWriteback(uint level, long long int addr)
+{
+    if(isLevelThreaded(level))
+        level_pipelines[level]->push({true, {addr, 0, false, 0}});
+    else
+        writeBackToLevel(level, addr);
+}
+
+
+bool CacheSimulator::releaseBlock(uint level, long long int addr, bool isDirty)
+{
+    if(inclusion != InclusionPolicy::INCLUSIVE) return isDirty;
+
+    // Upper copies go away with it, newer (dirty) data of theirs is written back by this level
+    bool isUpperDirty = false;
+    for(uint upper = 0; upper < level; upper++)
+    {
+        if(levels[upper].backInvalidate(addr).dirty_bit) isUpperDirty = true;
+    }
+    if(isUpperDirty && !isDirty) levels[level].addWriteback();
+    return isDirty || isUpperDirty;
+}
+
+
+void CacheSimulator::insertVictim(uint level, long long int addr, bool isDirty)
+{
+    Cache& cache = levels[level];
+
+    // The victim is written without a lookup (an exclusive level does not hold it) and is no miss: it comes with
+    // its data. What it displaces moves on down, out of the last level it goes to memory (counted if dirty)
+    cache.addWrite();
+    EvictedBlock evicted = cache.fillBlock(cache.getSetNumber(addr), -1, cache.getTag(addr), isDirty);
+    if(evicted.isValid && level + 1 < levels.size())
+    {
+        insertVictim(level + 1, evicted.addr, evicted.isDirty);
     }
 }
 
@@ -408,8 +486,7 @@ void CacheSimulator::sendWriteRequest(long long int addr)
 RawStatistics CacheSimulator::findRawStatistics()
 {
     RawStatistics raw_stats;
-    CacheStatistics l1_stats = l1_cache.getCacheStatistics();
-    CacheStatistics l2_stats = l2_cache.getCacheStatistics();
+    CacheStatistics l1_stats = levels[0].getCacheStatistics();
 
     raw_stats.l1_reads = l1_stats.n_reads;
     raw_stats.l1_read_misses = l1_stats.n_read_misses;
@@ -422,22 +499,63 @@ RawStatistics CacheSimulator::findRawStatistics()
 
     raw_stats.l1_vc_miss_rate = (double)(raw_stats.l1_read_misses + raw_stats.l1_write_misses - raw_stats.n_swaps)/ (raw_stats.l1_reads + raw_stats.l1_writes);
     raw_stats.l1_writebacks = l1_stats.n_writebacks;
+    raw_stats.l1_back_invalidations = l1_stats.n_back_invalidations;
+    if(isVCEnabled) raw_stats.l1_back_invalidations += levels[0].vc_cache->getCacheStatistics().n_back_invalidations;
 
-    raw_stats.l2_reads = l2_stats.n_reads;
-    raw_stats.l2_read_misses = l2_stats.n_read_misses;
-    raw_stats.l2_writes = l2_stats.n_writes;
-    raw_stats.l2_write_misses = l2_stats.n_write_misses;
-    raw_stats.l2_writebacks = l2_stats.n_writebacks;    
+    for(size_t level = 1; level < levels.size(); level++)
+    {
+        CacheStatistics stats = levels[level].getCacheStatistics();
+        LevelRawStatistics level_stats;
+        level_stats.reads = stats.n_reads;
+        level_stats.read_misses = stats.n_read_misses;
+        level_stats.writes = stats.n_writes;
+        level_stats.write_misses = stats.n_write_misses;
+        level_stats.miss_rate = (double)level_stats.read_misses / level_stats.reads;
+        level_stats.writebacks = stats.n_writebacks;
+        level_stats.back_invalidations = stats.n_back_invalidations;
+        raw_stats.lower_levels.push_back(level_stats);
+    }
+
+    raw_stats.n_split_accesses = n_split_accesses;
+    raw_stats.n_split_requests = n_split_requests;
+    raw_stats.inclusion = inclusion;
 
     if(isL2Exist)
     {
-        raw_stats.l2_miss_rate =  (double)raw_stats.l2_read_misses / raw_stats.l2_reads;
-        raw_stats.total_memory_traffic = raw_stats.l2_read_misses + raw_stats.l2_write_misses + raw_stats.l2_writebacks;
+        // Misses (fetches) and writebacks of the last level go to memory
+        const LevelRawStatistics& last_level = raw_stats.lower_levels.back();
+        raw_stats.total_memory_traffic = last_level.read_misses + last_level.write_misses + last_level.writebacks;
     }
     else
     {
         raw_stats.total_memory_traffic = raw_stats.l1_read_misses + raw_stats.l1_write_misses - raw_stats.n_swaps + raw_stats.l1_writebacks;
     }
+
+    if(isSetSamplingEnabled)
+    {
+        // Counts of the sampled sets stand for the whole cache (rates are left as they are)
+        double scale = set_sampler.getScale();
+        auto scaleCount = [scale] (uint& count) {count = (uint) llround(count * scale);};
+
+        scaleCount(raw_stats.l1_reads);
+        scaleCount(raw_stats.l1_read_misses);
+        scaleCount(raw_stats.l1_writes);
+        scaleCount(raw_stats.l1_write_misses);
+        scaleCount(raw_stats.n_swap_requests);
+        scaleCount(raw_stats.n_swaps);
+        scaleCount(raw_stats.l1_writebacks);
+        scaleCount(raw_stats.l1_back_invalidations);
+        for(LevelRawStatistics& level_stats : raw_stats.lower_levels)
+        {
+            scaleCount(level_stats.reads);
+            scaleCount(level_stats.read_misses);
+            scaleCount(level_stats.writes);
+            scaleCount(level_stats.write_misses);
+            scaleCount(level_stats.writebacks);
+            scaleCount(level_stats.back_invalidations);
+        }
+        raw_stats.total_memory_traffic = llround(raw_stats.total_memory_traffic * scale);
+    }
     return raw_stats;
 }
 
@@ -446,6 +564,7 @@ PerformanceStatistics CacheSimulator::findPerformanceStats()
 {
     PerformanceStatistics perf_stats;
     perf_stats.average_access_time = findAAT();
+    simulation_stats.perf_stats.average_access_time = perf_stats.average_access_time;  // used by findEDP
     perf_stats.energy_delay_product = findEDP();
     perf_stats.area_metric = findArea();
     return perf_stats;
@@ -459,46 +578,29 @@ SimulationStatistics CacheSimulator::getSimulationStats()
     return simulation_stats;
 }
 
-double CacheSimulator::findAAT()
+double CacheSimulator::findMissPenalty(uint blocksize)
 {
-    double aat = 0;
-    CacheStatistics l1_cache_stats = l1_cache.getCacheStatistics();
-    CacheStatistics l2_cache_stats = l2_cache.getCacheStatistics();
-    CacheStatistics vc_cache_stats; 
-    if(isVCEnabled) vc_cache_stats = *l1_cache.getCacheStatistics().vc_statistics;
-
     double main_memory_access_latency = 20;
-    double block_transfer_time = (double)l1_blocksize / 16;
-    double miss_penalty = main_memory_access_latency + block_transfer_time;
-
-    // cout << l1_cache_stats.hitTime << " " << l2_cache_stats.hitTime << " " << vc_cache_stats.hitTime << endl;
-    // cout << l1_cache_stats.energy << " " << l2_cache_stats.energy << " " << vc_cache_stats.energy << endl;
-    // cout << l1_cache_stats.area << " " << l2_cache_stats.area << " " << vc_cache_stats.area << endl;
+    double block_transfer_time = (double)blocksize / 16;
+    return main_memory_access_latency + block_transfer_time;
+}
 
-    // Only L1 
-    if(isVCEnabled == false && isL2Exist == false)
-    {
-        aat = l1_cache_stats.hitTime + (simulation_stats.raw_stats.l1_vc_miss_rate * miss_penalty);
-    }
 
-    // L1+VC
-    if(isVCEnabled == true && isL2Exist == false)
-    {
-        aat = l1_cache_stats.hitTime + (simulation_stats.raw_stats.swap_request_rate * vc_cache_stats.hitTime) + (simulation_stats.raw_stats.l1_vc_miss_rate * miss_penalty);
-    }
+double CacheSimulator::findAAT()
+{
+    CacheStatistics l1_cache_stats = levels[0].getCacheStatistics();
+    const RawStatistics& raw_stats = simulation_stats.raw_stats;
 
-    // L1+L2
-    if(isVCEnabled == false && isL2Exist == true)
+    // Time an L1 (+VC) miss takes: from memory up, every level adds its hit time and passes its misses down
+    double l1_miss_time = findMissPenalty(l1_blocksize);
+    for(size_t level = levels.size() - 1; level >= 1; level--)
     {
-        aat = l1_cache_stats.hitTime + (simulation_stats.raw_stats.l1_vc_miss_rate * (l2_cache_stats.hitTime + (simulation_stats.raw_stats.l2_miss_rate * miss_penalty)));
+        l1_miss_time = levels[level].getCacheStatistics().hitTime + (raw_stats.lower_levels[level - 1].miss_rate * l1_miss_time);
     }
 
-    // (L1+VC) + L2
-    if(isVCEnabled == true && isL2Exist == true)
-    {
-        aat = l1_cache_stats.hitTime + (simulation_stats.raw_stats.swap_request_rate * vc_cache_stats.hitTime) + 
-              (simulation_stats.raw_stats.l1_vc_miss_rate * (l2_cache_stats.hitTime + (simulation_stats.raw_stats.l2_miss_rate * miss_penalty)));
-    }
+    double aat = l1_cache_stats.hitTime;
+    if(isVCEnabled) aat += raw_stats.swap_request_rate * levels[0].vc_cache->getCacheStatistics().hitTime;
+    aat += raw_stats.l1_vc_miss_rate * l1_miss_time;
     return aat;
 }
 
@@ -506,9 +608,8 @@ double CacheSimulator::findAAT()
 double CacheSimulator::findArea()
 {
     double area = 0;
-    area += l1_cache.getCacheStatistics().area;
-    if(isL2Exist) area += l2_cache.getCacheStatistics().area;
-    if(isVCEnabled) area += l1_cache.getCacheStatistics().vc_statistics->area;
+    for(Cache& cache : levels) area += cache.getCacheStatistics().area;
+    if(isVCEnabled) area += levels[0].getCacheStatistics().vc_statistics->area;
     return area;
 }
 
@@ -517,75 +618,66 @@ double CacheSimulator::findEDP()
 {
     double edp = 0;
     double total_energy = 0;
-    double total_access_time = 0;
 
     double main_memory_access_energy = 0.05;
-    double main_memory_access_latency = 20;
 
-    CacheStatistics l1_cache_stats = l1_cache.getCacheStatistics();
-    CacheStatistics l2_cache_stats = l2_cache.getCacheStatistics();
-    CacheStatistics vc_cache_stats; 
-    if(isVCEnabled) vc_cache_stats = *l1_cache.getCacheStatistics().vc_statistics;
+    CacheStatistics l1_cache_stats = levels[0].getCacheStatistics();
     RawStatistics raw_stats = simulation_stats.raw_stats;
 
     total_energy += (raw_stats.l1_reads + raw_stats.l1_writes) * l1_cache_stats.energy;
     total_energy += (raw_stats.l1_read_misses + raw_stats.l1_write_misses) * l1_cache_stats.energy;
 
-    // total_access_time += (raw_stats.l1_reads + raw_stats.l1_writes) * l1_cache_stats.hitTime;
-    // total_access_time += (raw_stats.l1_read_misses + raw_stats.l1_write_misses) * l1_cache_stats.hitTime;
-
     if(isVCEnabled) 
     {
-        total_energy += (2 * raw_stats.n_swap_requests) * vc_cache_stats.energy;
-        // total_access_time += (2 * raw_stats.n_swap_requests) * vc_cache_stats.hitTime;
+        total_energy += (2 * raw_stats.n_swap_requests) * levels[0].vc_cache->getCacheStatistics().energy;
     }
 
-    if(isL2Exist)
+    for(size_t level = 1; level < levels.size(); level++)
     {
-        total_energy += (raw_stats.l2_reads + raw_stats.l2_writes) * l2_cache_stats.energy;
-        total_energy += (raw_stats.l2_read_misses + raw_stats.l2_write_misses) * l2_cache_stats.energy;
-        total_energy += (raw_stats.l2_read_misses + raw_stats.l2_write_misses) * main_memory_access_energy;
-        total_energy += raw_stats.l2_writebacks * main_memory_access_energy;
+        const LevelRawStatistics& level_stats = raw_stats.lower_levels[level - 1];
+        float energy = levels[level].getCacheStatistics().energy;
+        total_energy += (level_stats.reads + level_stats.writes) * energy;
+        total_energy += (level_stats.read_misses + level_stats.write_misses) * energy;
+    }
 
-        // total_access_time += (raw_stats.l2_reads + raw_stats.l2_writes) * l2_cache_stats.hitTime;
-        // total_access_time += (raw_stats.l2_read_misses + raw_stats.l2_write_misses) * l2_cache_stats.hitTime;
-        // total_access_time += (raw_stats.l2_read_misses + raw_stats.l2_write_misses) * main_memory_access_latency;
-        // total_access_time += raw_stats.l2_writebacks * main_memory_access_latency;
+    // Memory is accessed by the misses and writebacks of the last level
+    if(isL2Exist)
+    {
+        const LevelRawStatistics& last_level = raw_stats.lower_levels.back();
+        total_energy += (last_level.read_misses + last_level.write_misses) * main_memory_access_energy;
+        total_energy += last_level.writebacks * main_memory_access_energy;
     }
     else
     {
         total_energy += (raw_stats.l1_read_misses + raw_stats.l1_write_misses - raw_stats.n_swaps) * main_memory_access_energy;
         total_energy += raw_stats.l1_writebacks * main_memory_access_energy;
-
-        // total_access_time += (raw_stats.l1_read_misses + raw_stats.l1_write_misses - raw_stats.n_swaps) * main_memory_access_latency;
-        // total_access_time += raw_stats.l1_writebacks * main_memory_access_latency;
     }
     
-    // total_energy = total_energy / pow(10,9);
-    // total_access_time = total_access_time / pow(10, 9);
-    // cout << "total  energy " << total_energy << endl;
     edp = total_energy * simulation_stats.perf_stats.average_access_time * (raw_stats.l1_reads + raw_stats.l1_writes);
     return edp;
 }
 
 void CacheSimulator::printCacheContents()
 {
-    cout << endl;
-    cout << "===== L1 contents =====" << endl;
-    l1_cache.printCacheContents();
+    if(!isL1Replayed)
+    {
+        cout << endl;
+        cout << "===== L1 contents =====" << endl;
+        levels[0].printCacheContents();
+    }
 
-    if(isVCEnabled)
+    if(isVCEnabled && !isL1Replayed)
     {
         cout << endl;
         cout << "===== VC contents =====" << endl;
-        l1_cache.vc_cache->printCacheContents();
+        levels[0].vc_cache->printCacheContents();
     }
 
-    if(isL2Exist)
+    for(size_t level = 1; level < levels.size(); level++)
     {
         cout << endl;
-        cout << "===== L2 contents =====" << endl;
-        l2_cache.printCacheContents();
+        cout << "===== L" << level + 1 << " contents =====" << endl;
+        levels[level].printCacheContents();
     }
 }
 
@@ -598,5 +690,243 @@ void CacheSimulator::printSimulatorConfiguration()
     cout << "VC_NUM_BLOCKS:\t" << n_vc_blocks << endl;
     cout << "L2_SIZE:\t" << l2_size << endl;
     cout << "L2_ASSOC:\t" << l2_assoc << endl;
+    for(size_t i = 0; i < deeper_levels.size(); i++)
+    {
+        cout << "L" << i + 3 << "_SIZE:\t" << deeper_levels[i].size << endl;
+        cout << "L" << i + 3 << "_ASSOC:\t" << deeper_levels[i].assoc << endl;
+    }
     cout << "trace_file:\t" << trace_file_name << endl;
+    if(policy_kind != ReplacementPolicyKind::LRU) cout << "REPLACEMENT:\t" << getReplacementPolicyName(policy_kind) << endl;
+    if(inclusion != InclusionPolicy::NINE) cout << "INCLUSION:\t" << getInclusionPolicyName(inclusion) << endl;
+}
+
+
+void CacheSimulator::enablePCStatistics()
+{
+    isPCStatsEnabled = true;
+    for(Cache& cache : levels) cache.enablePCStatistics();
+}
+
+
+void CacheSimulator::printPCStatistics(uint n_top)
+{
+    auto printTopPCs = [n_top] (string level_name, const unordered_map<uint64_t, uint>& pc_misses)
+    {
+        vector<pair<uint64_t, uint>> sorted_misses(pc_misses.begin(), pc_misses.end());
+        sort(sorted_misses.begin(), sorted_misses.end(), [] (const pair<uint64_t, uint>& a, const pair<uint64_t, uint>& b)
+        {
+            return (a.second != b.second) ? a.second > b.second : a.first < b.first;
+        });
+        if(sorted_misses.size() > n_top) sorted_misses.resize(n_top);
+
+        cout << endl;
+        cout << "===== " << level_name << " misses per PC (top " << dec << n_top << ") =====" << endl;
+        for(auto& pc_miss : sorted_misses)
+        {
+            cout << "  " << hex << pc_miss.first << ":\t" << dec << pc_miss.second << endl;
+        }
+    };
+
+    printTopPCs("L1", levels[0].getPCMisses());
+    if(isVCEnabled) printTopPCs("VC", levels[0].vc_cache->getPCMisses());
+    for(size_t level = 1; level < levels.size(); level++)
+    {
+        printTopPCs("L" + to_string(level + 1), levels[level].getPCMisses());
+    }
+}
+
+
+uint CacheSimulator::findSetGroupCount()
+{
+    uint n_groups = UINT_MAX;
+    for(Cache& cache : levels) n_groups = min(n_groups, cache.getSetCount());
+    return 1u << (uint) log2(n_groups);
+}
+
+
+void CacheSimulator::enableSetSampling(double fraction)
+{
+    set_sampler = SetSampler(findSetGroupCount(), l1_blocksize, fraction);
+    isSetSamplingEnabled = true;
+}
+
+
+/*
+ * @brief Adds the event counters of `part` to `total`
+ */
+static void addCounters(CacheStatistics& total, const CacheStatistics& part)
+{
+    total.n_reads += part.n_reads;
+    total.n_read_misses += part.n_read_misses;
+    total.n_writes += part.n_writes;
+    total.n_write_misses += part.n_write_misses;
+    total.n_swap_requests += part.n_swap_requests;
+    total.n_swaps += part.n_swaps;
+    total.n_writebacks += part.n_writebacks;
+    total.n_back_invalidations += part.n_back_invalidations;
+}
+
+
+void CacheSimulator::mergeSetPartition(CacheSimulator& shard)
+{
+    for(size_t level = 0; level < levels.size(); level++)
+    {
+        for(uint set = 0; set < levels[level].getSetCount(); set++)
+        {
+            if(shard.isSetInPartition(set)) levels[level].copySet(shard.levels[level], set);
+        }
+    }
+
+    HierarchyCounters counters = getCounters();
+    HierarchyCounters shard_counters = shard.getCounters();
+    for(size_t level = 0; level < levels.size(); level++)
+    {
+        addCounters(counters.level_stats[level], shard_counters.level_stats[level]);
+    }
+    setCounters(counters);
+
+    if(isPCStatsEnabled)
+    {
+        for(size_t level = 0; level < levels.size(); level++)
+        {
+            levels[level].addPCMisses(shard.levels[level].getPCMisses());
+        }
+    }
+}
+
+
+void CacheSimulator::recordSampledAccess(long long int addr)
+{
+    CacheStatistics l1_stats = levels[0].getCacheStatistics();
+
+    SetGroupCounters totals;
+    totals.n_accesses = l1_stats.n_reads + l1_stats.n_writes;
+    totals.n_misses = l1_stats.n_read_misses + l1_stats.n_write_misses - l1_stats.n_swaps;
+    totals.n_swap_requests = l1_stats.n_swap_requests;
+    if(isL2Exist) totals.n_l2_read_misses = levels[1].getCacheStatistics().n_read_misses;
+
+    set_sampler.recordAccess(addr, totals);
+}
+
+
+void CacheSimulator::printSetSamplingStatistics()
+{
+    if(!isSetSamplingEnabled) return;
+
+    double l1_hit_time = levels[0].getCacheStatistics().hitTime;
+    double vc_hit_time = isVCEnabled ? levels[0].getCacheStatistics().vc_statistics->hitTime : 0;
+    double miss_penalty = findMissPenalty(l1_blocksize);
+    SampledEstimate aat = isL2Exist ? set_sampler.estimateAAT(l1_hit_time, vc_hit_time, levels[1].getCacheStatistics().hitTime, miss_penalty)
+                                    : set_sampler.estimateAAT(l1_hit_time, vc_hit_time, miss_penalty, 0);
+    SampledEstimate miss_rate = set_sampler.estimateMissRate();
+
+    cout << endl;
+    cout << fixed << setprecision(4) << dec;
+    cout << "===== Set sampling (" << set_sampler.getSampledGroupCount() << " of " << set_sampler.getGroupCount()
+         << " set groups, 95% confidence) =====" << endl;
+    cout << "  combined L1+VC miss rate:\t\t" << miss_rate.value << " +/- " << miss_rate.half_width << endl;
+    if(isL2Exist)
+    {
+        SampledEstimate l2_miss_rate = set_sampler.estimateL2MissRate();
+        cout << "  L2 miss rate:\t\t" << l2_miss_rate.value << " +/- " << l2_miss_rate.half_width << endl;
+    }
+    cout << "  average access time:\t\t" << aat.value << " +/- " << aat.half_width << endl;
+}
+
+
+HierarchyCounters CacheSimulator::getCounters()
+{
+    HierarchyCounters counters;
+    for(Cache& cache : levels) counters.level_stats.push_back(cache.getCacheStatistics());
+    if(isVCEnabled) counters.vc_stats = levels[0].vc_cache->getCacheStatistics();
+    counters.n_split_accesses = n_split_accesses;
+    counters.n_split_requests = n_split_requests;
+    return counters;
+}
+
+
+void CacheSimulator::setCounters(const HierarchyCounters& counters)
+{
+    for(size_t level = 0; level < levels.size(); level++) levels[level].setCacheStatistics(counters.level_stats[level]);
+    if(isVCEnabled) levels[0].vc_cache->setCacheStatistics(counters.vc_stats);
+    n_split_accesses = counters.n_split_accesses;
+    n_split_requests = counters.n_split_requests;
+}
+
+
+bool CacheSimulator::recordFilterTrace(string filePath)
+{
+    filter_trace_writer.reset(new FilterTraceWriter(filePath, l1_size, l1_assoc, l1_blocksize, n_vc_blocks));
+    return filter_trace_writer->isOpen();
+}
+
+
+bool CacheSimulator::closeFilterTrace()
+{
+    if(!filter_trace_writer) return false;
+
+    HierarchyCounters counters = getCounters();
+    bool isWritten = filter_trace_writer->close(counters.level_stats[0], counters.vc_stats, counters.n_split_accesses, counters.n_split_requests);
+    filter_trace_writer.reset();
+    return isWritten;
+}
+
+
+void CacheSimulator::replayFilterTrace(FilterTraceReader& reader)
+{
+    isL1Replayed = true;
+
+    FilterTraceRecord record;
+    while(reader.read(record))
+    {
+        if(isL2Exist) fetchFromLevel(1, record.addr, 0, record.hasWriteback, record.writeback_addr, true);
+    }
+
+    HierarchyCounters counters = getCounters();
+    reader.getCounters(counters.level_stats[0], counters.vc_stats);
+    counters.n_split_accesses = reader.getHeader().n_split_accesses;
+    counters.n_split_requests = reader.getHeader().n_split_requests;
+    setCounters(counters);
+}
+
+
+void CacheSimulator::startLevelThreads()
+{
+    // A level thread runs on the requests the level above passes down, only NINE levels leave the level above
+    // independent of them
+    if(!isL2Exist || !level_pipelines.empty() || inclusion != InclusionPolicy::NINE) return;
+
+    // Bottom up, so that a level's pipeline exists before the level above can queue for it
+    level_pipelines.resize(levels.size());
+    for(uint level = levels.size() - 1; level >= 1; level--)
+    {
+        level_pipelines[level].reset(new LevelPipeline([this, level] (const LevelRequest* requests, size_t n_requests)
+        {
+            for(size_t i = 0; i < n_requests; i++)
+            {
+                const FilterTraceRecord& record = requests[i].record;
+                if(requests[i].isWritebackOnly)
+                    writeBackToLevel(level, record.addr);
+                else
+                    fetchFromLevel(level, record.addr, record.pc, record.hasWriteback, record.writeback_addr, true);
+            }
+        }));
+    }
+}
+
+
+void CacheSimulator::finishLevelThreads()
+{
+    // Top down: once a level has simulated all its requests, it has queued all of those of the level below
+    for(uint level = 1; level < level_pipelines.size(); level++) level_pipelines[level]->finish();
+    if(level_pipelines.empty()) return;
+
+    cerr << endl;
+    cerr << "===== Level pipelines =====" << endl;
+    for(uint level = 1; level < level_pipelines.size(); level++)
+    {
+        cerr << "  L" << level << " stalls (ring to L" << level + 1 << " full):\t\t" << level_pipelines[level]->getProducerStalls() << endl;
+        cerr << "  L" << level + 1 << " stalls (ring empty):\t\t" << level_pipelines[level]->getConsumerStalls() << endl;
+    }
+    level_pipelines.clear();
 }
@@ -0,0 +1,108 @@
+#include "cactiMemo.h"
+#include "parse.h"
+#include "threadPool.h"
+#include<fstream>
+#include<sstream>
+#include<cstdio>
+
+CactiMemo::CactiMemo(string filePath)
+{
+    this->filePath = filePath;
+    load();
+}
+
+
+CactiMemo& CactiMemo::getInstance()
+{
+    static CactiMemo memo(CACTI_MEMO_PATH);
+    return memo;
+}
+
+
+tuple<uint, uint, uint> CactiMemo::makeKey(uint cache_size, uint block_size, uint assoc)
+{
+    // Fully associative geometries are one key whatever the way count is called
+    if(assoc == cache_size / block_size) assoc = 0;
+    return make_tuple(cache_size, block_size, assoc);
+}
+
+
+void CactiMemo::load()
+{
+    ifstream file(filePath);
+    string line;
+
+    while(getline(file, line))
+    {
+        istringstream fields(line);
+        uint cache_size, block_size;
+        string assoc, tech_node, status;
+        CactiResult result;
+        if(!(fields >> cache_size >> block_size >> assoc >> tech_node >> result.hitTime >> result.energy >> result.area >> status)) continue;
+        if(tech_node != CACTI_TECH_NODE || block_size == 0) continue;
+
+        result.isValid = (status == "ok");
+        results[make_tuple(cache_size, block_size, assoc == "FA" ? 0 : (uint) stoul(assoc))] = result;
+    }
+}
+
+
+void CactiMemo::append(const tuple<uint, uint, uint>& geometry, const CactiResult& result)
+{
+    FILE* file = fopen(filePath.c_str(), "a");
+    if(file == nullptr) return;     // read-only directory: results stay memoized in this process only
+
+    string assoc = get<2>(geometry) == 0 ? "FA" : to_string(get<2>(geometry));
+    fprintf(file, "%u %u %s %s %.9g %.9g %.9g %s\n", get<0>(geometry), get<1>(geometry), assoc.c_str(), CACTI_TECH_NODE,
+            result.hitTime, result.energy, result.area, result.isValid ? "ok" : "failed");
+    fclose(file);
+}
+
+
+CactiResult CactiMemo::find(uint cache_size, uint block_size, uint assoc)
+{
+    auto geometry = makeKey(cache_size, block_size, assoc);
+    {
+        lock_guard<mutex> lock(results_mutex);
+        auto memo_entry = results.find(geometry);
+        if(memo_entry != results.end()) return memo_entry->second;
+    }
+
+    // CACTI runs outside the lock, so threads of a sweep run it for different geometries at once
+    CactiResult result = {0, 0, 0, true};
+    if(get_cacti_results(cache_size, block_size, assoc, &result.hitTime, &result.energy, &result.area) > 0)
+    {
+        cerr << "CACTI failed for " << cache_size << " B, " << block_size << " B blocks, "
+             << (get<2>(geometry) == 0 ? string("FA") : to_string(assoc)) << ": hit time " << CACTI_FALLBACK_HIT_TIME << " ns assumed" << endl;
+        result.hitTime = CACTI_FALLBACK_HIT_TIME;
+        result.isValid = false;
+    }
+
+    lock_guard<mutex> lock(results_mutex);
+    if(results.insert(make_pair(geometry, result)).second) append(geometry, result);
+    return result;
+}
+
+
+size_t CactiMemo::populate(const vector<tuple<uint, uint, uint>>& geometries, uint n_threads)
+{
+    // Memo key -> one geometry of it
+    map<tuple<uint, uint, uint>, tuple<uint, uint, uint>> missing;
+    {
+        lock_guard<mutex> lock(results_mutex);
+        for(auto& geometry : geometries)
+        {
+            auto key = makeKey(get<0>(geometry), get<1>(geometry), get<2>(geometry));
+            if(results.count(key) == 0) missing[key] = geometry;
+        }
+    }
+
+    ThreadPool pool(n_threads);
+    for(auto& key_geometry : missing)
+    {
+        tuple<uint, uint, uint> geometry = key_geometry.second;
+        pool.submit([this, geometry] () {find(get<0>(geometry), get<1>(geometry), get<2>(geometry));});
+    }
+    pool.waitAll();
+    return missing.size();
+}
@@ -0,0 +1,211 @@
+#include "filterTrace.h"
+#include<cstring>
+#include<cstdlib>
+#include<cmath>
+
+// Bytes of records collected before a write to the file
+#define FILTER_WRITER_BUFFER_SIZE (1 << 20)
+
+static void packCounters(const CacheStatistics& stats, uint64_t* counters)
+{
+    counters[0] = stats.n_reads;
+    counters[1] = stats.n_read_misses;
+    counters[2] = stats.n_writes;
+    counters[3] = stats.n_write_misses;
+    counters[4] = stats.n_swap_requests;
+    counters[5] = stats.n_swaps;
+    counters[6] = stats.n_writebacks;
+}
+
+
+static void unpackCounters(const uint64_t* counters, CacheStatistics& stats)
+{
+    stats.n_reads = counters[0];
+    stats.n_read_misses = counters[1];
+    stats.n_writes = counters[2];
+    stats.n_write_misses = counters[3];
+    stats.n_swap_requests = counters[4];
+    stats.n_swaps = counters[5];
+    stats.n_writebacks = counters[6];
+}
+
+
+/****************************
+*** FILTER TRACE WRITER *****
+****************************/
+
+FilterTraceWriter::FilterTraceWriter(string filePath, uint l1_size, uint l1_assoc, uint l1_blocksize, uint n_vc_blocks)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILTER_TRACE_MAGIC, sizeof(header.magic));
+    header.version = FILTER_TRACE_VERSION;
+    header.l1_size = l1_size;
+    header.l1_assoc = l1_assoc;
+    header.l1_blocksize = l1_blocksize;
+    header.n_vc_blocks = n_vc_blocks;
+
+    n_blockOffsetBits = log2(l1_blocksize);
+    prev_block = 0;
+    buffer.reserve(FILTER_WRITER_BUFFER_SIZE);
+
+    file = fopen(filePath.c_str(), "wb");
+    if(file != nullptr && fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+
+FilterTraceWriter::~FilterTraceWriter()
+{
+    if(file != nullptr) fclose(file);
+}
+
+
+void FilterTraceWriter::flushBuffer()
+{
+    if(!buffer.empty()) fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+}
+
+
+void FilterTraceWriter::writeVarint(uint64_t low, uint64_t high)
+{
+    while(high != 0 || low >= 0x80)
+    {
+        buffer.push_back((low & 0x7f) | 0x80);
+        low = (low >> 7) | (high << 57);
+        high = 0;
+    }
+    buffer.push_back(low);
+}
+
+
+void FilterTraceWriter::write(long long int addr, bool hasWriteback, long long int writeback_addr)
+{
+    if(buffer.size() + 2 * 10 > FILTER_WRITER_BUFFER_SIZE) flushBuffer();
+
+    uint64_t block = (uint64_t) addr >> n_blockOffsetBits;
+    int64_t delta = (int64_t)(block - prev_block);
+    uint64_t zigzag_delta = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    prev_block = block;
+
+    // varint of up to 65 bits: low 64 bits + the 65th bit
+    writeVarint((zigzag_delta << 1) | (hasWriteback ? 1 : 0), zigzag_delta >> 63);
+
+    if(hasWriteback)
+    {
+        int64_t writeback_delta = (int64_t)(((uint64_t) writeback_addr >> n_blockOffsetBits) - block);
+        writeVarint(((uint64_t)writeback_delta << 1) ^ (uint64_t)(writeback_delta >> 63), 0);
+    }
+    header.n_records++;
+}
+
+
+bool FilterTraceWriter::close(const CacheStatistics& l1_stats, const CacheStatistics& vc_stats, uint n_split_accesses, uint n_split_requests)
+{
+    if(file == nullptr) return false;
+
+    packCounters(l1_stats, header.l1_counters);
+    packCounters(vc_stats, header.vc_counters);
+    header.n_split_accesses = n_split_accesses;
+    header.n_split_requests = n_split_requests;
+
+    flushBuffer();
+    bool isWritten = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    isWritten = (ferror(file) == 0) && isWritten;
+    isWritten = (fclose(file) == 0) && isWritten;
+    file = nullptr;
+    return isWritten;
+}
+
+
+/****************************
+*** FILTER TRACE READER *****
+****************************/
+
+FilterTraceReader::FilterTraceReader(string filePath)
+{
+    prev_block = 0;
+    n_records_read = 0;
+    memset(&header, 0, sizeof(header));
+
+    file = fopen(filePath.c_str(), "rb");
+    if(file == nullptr) return;
+
+    bool isValid = fread(&header, sizeof(header), 1, file) == 1 &&
+                   memcmp(header.magic, FILTER_TRACE_MAGIC, sizeof(header.magic)) == 0 &&
+                   header.version == FILTER_TRACE_VERSION && header.l1_blocksize > 0;
+    if(!isValid)
+    {
+        cerr << "Invalid filter trace file header - " << filePath << endl;
+        exit(EXIT_FAILURE);
+    }
+    n_blockOffsetBits = log2(header.l1_blocksize);
+}
+
+
+FilterTraceReader::~FilterTraceReader()
+{
+    if(file != nullptr) fclose(file);
+}
+
+
+bool FilterTraceReader::readVarint(uint64_t& low, uint64_t& high)
+{
+    low = 0;
+    high = 0;
+    int shift = 0;
+
+    while(true)
+    {
+        int byte = getc_unlocked(file);
+        if(byte == EOF) return false;
+
+        low |= (uint64_t)(byte & 0x7f) << shift;
+        if(shift == 63) high = (byte & 0x7f) >> 1;
+
+        if((byte & 0x80) == 0) return true;
+        shift += 7;
+        if(shift > 63) return false;
+    }
+}
+
+
+bool FilterTraceReader::read(FilterTraceRecord& record)
+{
+    if(n_records_read == header.n_records) return false;
+
+    uint64_t low, high;
+    bool isValid = readVarint(low, high);
+
+    uint64_t zigzag_delta = (low >> 1) | (high << 63);
+    prev_block += (zigzag_delta >> 1) ^ (0 - (zigzag_delta & 1));
+    record.addr = prev_block << n_blockOffsetBits;
+    record.pc = 0;
+    record.hasWriteback = (low & 1) != 0;
+    record.writeback_addr = 0;
+
+    if(isValid && record.hasWriteback)
+    {
+        isValid = readVarint(low, high);
+        uint64_t writeback_delta = (low >> 1) ^ (0 - (low & 1));
+        record.writeback_addr = (prev_block + writeback_delta) << n_blockOffsetBits;
+    }
+
+    if(!isValid)
+    {
+        cerr << "Truncated filter trace file (Record: " << n_records_read + 1 << ")" << endl;
+        exit(EXIT_FAILURE);
+    }
+    n_records_read++;
+    return true;
+}
+
+
+void FilterTraceReader::getCounters(CacheStatistics& l1_stats, CacheStatistics& vc_stats)
+{
+    unpackCounters(header.l1_counters, l1_stats);
+    unpackCounters(header.vc_counters, vc_stats);
+}
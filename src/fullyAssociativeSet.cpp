@@ -0,0 +1,61 @@
+#include "fullyAssociativeSet.h"
+
+uint FullyAssociativeSet::findSlotCount(uint n_ways)
+{
+    uint n_slots = 2;
+    while(n_slots < 2 * n_ways) n_slots *= 2;
+    return n_slots;
+}
+
+
+void RecencyList::initRecord(int* record, uint n_ways)
+{
+    int* prev_way = record + 2;
+    int* next_way = record + 2 + n_ways;
+    for(uint way = 0; way < n_ways; way++)
+    {
+        prev_way[way] = (int) way - 1;
+        next_way[way] = (way + 1 < n_ways) ? (int) way + 1 : -1;
+    }
+    record[0] = 0;
+    record[1] = (int) n_ways - 1;
+}
+
+
+void FullyAssociativeSet::insert(uint64_t tag, int way)
+{
+    uint slot = findHomeSlot(tag);
+    while(slots[slot].way != -1) slot = (slot + 1) & slot_mask;
+    slots[slot].tag = tag;
+    slots[slot].way = way;
+}
+
+
+void FullyAssociativeSet::erase(uint64_t tag)
+{
+    uint slot = findHomeSlot(tag);
+    while(slots[slot].way != -1 && slots[slot].tag != tag) slot = (slot + 1) & slot_mask;
+    if(slots[slot].way == -1) return;
+
+    // Backward shift: entries of the probe run after the hole move into it unless that would put them before their home slot
+    uint hole = slot;
+    for(uint next = (hole + 1) & slot_mask; slots[next].way != -1; next = (next + 1) & slot_mask)
+    {
+        uint home = findHomeSlot(slots[next].tag);
+        bool isHomeAfterHole = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if(isHomeAfterHole) continue;
+
+        slots[hole] = slots[next];
+        hole = next;
+    }
+    slots[hole].way = -1;
+}
+
+
+vector<int> RecencyList::getRecencyOrder() const
+{
+    vector<int> order;
+    order.reserve(n_ways);
+    for(int way = head; way != -1; way = next_way[way]) order.push_back(way);
+    return order;
+}
@@ -0,0 +1,68 @@
+#include "levelPipeline.h"
+
+LevelPipeline::LevelPipeline(function<void(const LevelRequest*, size_t)> consume) : ring(LEVEL_RING_BATCHES)
+{
+    this->consume = consume;
+    batch = nullptr;
+    n_producer_stalls = 0;
+    n_consumer_stalls = 0;
+    consumer = thread(&LevelPipeline::drain, this);
+}
+
+
+LevelPipeline::~LevelPipeline()
+{
+    if(consumer.joinable()) finish();
+}
+
+
+void LevelPipeline::acquireBatch()
+{
+    batch = ring.tryAcquireWrite();
+    if(batch == nullptr)
+    {
+        n_producer_stalls++;
+        while((batch = ring.tryAcquireWrite()) == nullptr) this_thread::yield();
+    }
+    batch->n_requests = 0;
+}
+
+
+void LevelPipeline::publishBatch(size_t n_requests)
+{
+    batch->n_requests = n_requests;
+    ring.publishWrite();
+    batch = nullptr;
+}
+
+
+void LevelPipeline::drain()
+{
+    while(true)
+    {
+        LevelRequestBatch* next_batch = ring.tryAcquireRead();
+        if(next_batch == nullptr)
+        {
+            n_consumer_stalls++;
+            while((next_batch = ring.tryAcquireRead()) == nullptr) this_thread::yield();
+        }
+
+        size_t n_requests = next_batch->n_requests;
+        consume(next_batch->requests, n_requests);
+        ring.releaseRead();
+
+        if(n_requests == 0) break;
+    }
+}
+
+
+void LevelPipeline::finish()
+{
+    if(batch != nullptr && batch->n_requests > 0) publishBatch(batch->n_requests);
+
+    // End marker
+    if(batch == nullptr) acquireBatch();
+    publishBatch(0);
+
+    consumer.join();
+}
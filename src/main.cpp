@@ -1,18 +1,508 @@
 #include "cacheSimulator.h"
-#include<fstream>
+#include "tracePipeline.h"
+#include "progressReporter.h"
+#include "sweep.h"
+#include "stackDistance.h"
+#include "shards.h"
+#include "simPoint.h"
+#include "cactiMemo.h"
 #include<string>
 #include<cstdlib>
+#include<cstring>
+#include<thread>
+#include<chrono>
+#include<iomanip>
+#include<algorithm>
 
 #define TRACE_DIR_PATH "trace_files/"
 
+// PCs listed per level by --pc-stats
+#define PC_STATS_TOP 10
+
+/*
+ * Usage: ./cache_sim <L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC> <trace_file> [options]
+ *        ./cache_sim --sweep <config_file> <trace_file> [options]
+ *        ./cache_sim --mrc <L1_BLOCKSIZE> <trace_file> [options]
+ *        ./cache_sim --shards <BLOCKSIZE> <trace_file> [options]
+ *        ./cache_sim --replay-l2 <filter_trace> <L2_SIZE> <L2_ASSOC>
+ *        ./cache_sim --cacti <config_file> [--threads=<n>]
+ *
+ * <trace_file> is looked up in trace_files/, unless it is an absolute path or "-" (stdin).
+ * --sweep simulates every configuration of <config_file> (see SweepEngine::readConfigs) and prints one CSV row each.
+ * --mrc prints the exact LRU miss ratio (and L1-only AAT) of every size x associativity (and fully associative) L1
+ *       from a single stack-distance pass.
+ * --shards prints approximate fully associative LRU miss ratios (with standard errors) of every size from a hash-sampled
+ *       stack-distance pass whose memory stays under --memory, whatever the trace footprint. Sizes stand for L1 or L2
+ *       capacities alike: the L2 local miss rate of an L1/L2 pair is close to miss_rate(L2) / miss_rate(L1).
+ * --replay-l2 simulates only an L2 behind the L1 (+VC) recorded in <filter_trace> (see --record-l2), the statistics
+ *       equal those of the full simulation; L1 / VC contents are not printed.
+ * --cacti runs CACTI in parallel for every L1, VC and L2 geometry of a sweep <config_file> not yet in cacti_memo.txt.
+ *       Every run looks CACTI results up in that file first and only runs CACTI for geometries missing from it.
+ *
+ * Options:
+ *   --pipeline     decode the trace on a separate thread, overlapped with the simulation
+ *   --progress     print progress to stderr periodically (always on for stdin / pipes), with the accesses per second
+ *   --prefetch=<n> prefetch the L1 / L2 set metadata of the access n accesses ahead (default: 8, 0: off; same results)
+ *   --format=<f>   trace format: auto (default), text, din, lackey, champsim (binary and compressed are always detected)
+ *   --no-ifetch    drop the instruction fetches of din / lackey / champsim traces instead of simulating them as reads
+ *   --pc-stats     print the PCs with the most misses per level (traces with PCs: text `r <hex> <size> <pc>`, lackey, champsim)
+ *   --threads=<n>  worker threads of a sweep or of --set-threads (default: all cores)
+ *   --sizes=<list> comma separated cache sizes of --mrc (default: 2048,4096,...,1048576)
+ *   --assocs=<list> comma separated associativities of --mrc (default: 1,2,4,8), fully associative is always added
+ *   --memory=<MB>  memory budget of --shards (default: 4)
+ *   --sample=<f>   simulate only a fraction f of the sets (same set groups in L1 and L2), scale the counts and print
+ *                  95% confidence intervals of the miss rates and AAT (also applies to --sweep); not with a victim
+ *                  cache, which all L1 sets share (it would hold the victims of the sampled sets only)
+ *   --simpoint=<n> two passes over the trace file: cluster intervals of n accesses by their block address signature,
+ *                  simulate one interval per cluster, only warm the caches with the rest and weight the results
+ *   --clusters=<k> maximum number of simulation points of --simpoint (default: 10)
+ *   --level-threads simulate every level below L1 on a thread of its own, each fed with the misses and writebacks
+ *                  of the level above (same results); sequential without an L2, with inclusive / exclusive levels,
+ *                  --sample, --simpoint or --set-threads
+ *   --set-threads  split the sets over --threads threads, each simulating the whole trace for its own sets (same
+ *                  results); sequential with a victim cache, which all sets share
+ *   --policy=<p>   replacement policy of every level: lru (default), plru (tree pseudo-LRU), srrip, brrip, fifo, random
+ *   --record-l2=<path> write the requests L1 (+VC) sends to the next level (misses and writebacks) to an L1 filter
+ *                  trace, to replay it with any L2 (record with L2_SIZE 0 to simulate L1 only); not with --simpoint
+ *   --l3=<size>,<assoc> add an L3 below L2 (with the L1 block size)
+ *   --l4=<size>,<assoc> add an L4 below L3
+ *   --inclusion=<p> inclusion policy of the levels below L1: nine (default, non-inclusive non-exclusive), inclusive
+ *                  (evictions back-invalidate the levels above) or exclusive (a block lives in one level, victims move
+ *                  down); --level-threads and --record-l2 need nine, --sample at most two levels
+ */
+struct SimulatorOptions
+{
+    bool isPipelined = false;
+    bool isProgressEnabled = false;
+    bool isIFetchIncluded = true;
+    bool isPCStatsEnabled = false;
+    bool isLevelPipelined = false;
+    bool isSetParallel = false;
+    TraceFormat trace_format = TraceFormat::AUTO;
+    uint n_threads = thread::hardware_concurrency();
+    uint prefetch_distance = REQUEST_PREFETCH_DISTANCE;
+    vector<uint> mrc_sizes = {2048, 4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576};
+    vector<uint> mrc_assocs = {1, 2, 4, 8};
+    double memory_budget_mb = 4;
+    double sample_fraction = 1;     // 1: every set is simulated
+    uint64_t simpoint_interval = 0; // 0: the whole trace is simulated
+    uint simpoint_clusters = 10;
+    string filter_trace_path;       // --record-l2 output, empty: not recorded
+    ReplacementPolicyKind policy_kind = ReplacementPolicyKind::LRU;
+    InclusionPolicy inclusion = InclusionPolicy::NINE;
+    vector<uint> l3_geometry;       // --l3 size, assoc, empty: no L3
+    vector<uint> l4_geometry;
+
+    /*
+     * @brief Parses a comma separated list of positive numbers
+     */
+    static bool parseList(const char* list, vector<uint>& values)
+    {
+        values.clear();
+        char* end;
+        do
+        {
+            long value = strtol(list, &end, 10);
+            if(end == list || value <= 0) return false;
+            values.push_back(value);
+            list = end + 1;
+        } while(*end == ',');
+        return *end == '\0';
+    }
+
+    /*
+     * @return false if an option is not recognized
+     */
+    bool parse(int argc, char* argv[], int first_option)
+    {
+        for(int i = first_option; i < argc; i++)
+        {
+            if(strcmp(argv[i], "--pipeline") == 0) isPipelined = true;
+            else if(strcmp(argv[i], "--progress") == 0) isProgressEnabled = true;
+            else if(strcmp(argv[i], "--no-ifetch") == 0) isIFetchIncluded = false;
+            else if(strcmp(argv[i], "--pc-stats") == 0) isPCStatsEnabled = true;
+            else if(strcmp(argv[i], "--level-threads") == 0) isLevelPipelined = true;
+            else if(strcmp(argv[i], "--set-threads") == 0) isSetParallel = true;
+            else if(strncmp(argv[i], "--format=", 9) == 0)
+            {
+                if(!parseTraceFormat(argv[i] + 9, trace_format)) return false;
+            }
+            else if(strncmp(argv[i], "--policy=", 9) == 0)
+            {
+                if(!parseReplacementPolicy(argv[i] + 9, policy_kind)) return false;
+            }
+            else if(strncmp(argv[i], "--inclusion=", 12) == 0)
+            {
+                if(!parseInclusionPolicy(argv[i] + 12, inclusion)) return false;
+            }
+            else if(strncmp(argv[i], "--l3=", 5) == 0)
+            {
+                if(!parseList(argv[i] + 5, l3_geometry) || l3_geometry.size() != 2) return false;
+            }
+            else if(strncmp(argv[i], "--l4=", 5) == 0)
+            {
+                if(!parseList(argv[i] + 5, l4_geometry) || l4_geometry.size() != 2) return false;
+            }
+            else if(strncmp(argv[i], "--sizes=", 8) == 0)
+            {
+                if(!parseList(argv[i] + 8, mrc_sizes)) return false;
+            }
+            else if(strncmp(argv[i], "--assocs=", 9) == 0)
+            {
+                if(!parseList(argv[i] + 9, mrc_assocs)) return false;
+            }
+            else if(strncmp(argv[i], "--memory=", 9) == 0)
+            {
+                memory_budget_mb = atof(argv[i] + 9);
+                if(memory_budget_mb <= 0) return false;
+            }
+            else if(strncmp(argv[i], "--sample=", 9) == 0)
+            {
+                sample_fraction = atof(argv[i] + 9);
+                if(sample_fraction <= 0 || sample_fraction > 1) return false;
+            }
+            else if(strncmp(argv[i], "--simpoint=", 11) == 0)
+            {
+                simpoint_interval = strtoull(argv[i] + 11, nullptr, 10);
+                if(simpoint_interval == 0) return false;
+            }
+            else if(strncmp(argv[i], "--clusters=", 11) == 0)
+            {
+                simpoint_clusters = atoi(argv[i] + 11);
+                if(simpoint_clusters == 0) return false;
+            }
+            else if(strncmp(argv[i], "--record-l2=", 12) == 0)
+            {
+                filter_trace_path = argv[i] + 12;
+                if(filter_trace_path.empty()) return false;
+            }
+            else if(strncmp(argv[i], "--threads=", 10) == 0)
+            {
+                n_threads = atoi(argv[i] + 10);
+                if(n_threads == 0) return false;
+            }
+            else if(strncmp(argv[i], "--prefetch=", 11) == 0)
+            {
+                char* end;
+                prefetch_distance = strtoul(argv[i] + 11, &end, 10);
+                if(end == argv[i] + 11 || *end != '\0') return false;
+            }
+            else return false;
+        }
+        return !l4_geometry.empty() ? !l3_geometry.empty() : true;
+    }
+
+    /*
+     * @brief L3 and L4 of --l3 / --l4
+     */
+    vector<LevelGeometry> getDeeperLevels() const
+    {
+        vector<LevelGeometry> deeper_levels;
+        if(!l3_geometry.empty()) deeper_levels.push_back({l3_geometry[0], l3_geometry[1]});
+        if(!l4_geometry.empty()) deeper_levels.push_back({l4_geometry[0], l4_geometry[1]});
+        return deeper_levels;
+    }
+};
+
+
+/*
+ * @brief "-" is stdin, absolute paths (e.g. named pipes) are used as they are, other traces live in trace_files/
+ */
+string findTracePath(string traceFileName)
+{
+    if(traceFileName == "-" || traceFileName[0] == '/') return traceFileName;
+    return TRACE_DIR_PATH + traceFileName;
+}
+
+
+/*
+ * @brief Decodes the trace once and simulates every configuration of the sweep file on it
+ */
+int runSweep(string configFilePath, string traceFileName, SimulatorOptions& options)
+{
+    SweepEngine sweep;
+    if(!sweep.readConfigs(configFilePath))
+    {
+        cerr << "Error in opening file - " << configFilePath << endl;
+        return EXIT_FAILURE;
+    }
+    for(const SweepConfig& config : sweep.getConfigs())
+    {
+        if(options.sample_fraction < 1 && config.n_vc_blocks > 0)
+        {
+            cerr << "--sample needs VC_NUM_BLOCKS 0 in every configuration (the victim cache is shared by every L1 set)" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    string traceFilePath = findTracePath(traceFileName);
+    Trace trace(traceFilePath, options.trace_format, options.isIFetchIncluded);
+    if(!trace.isOpen())
+    {
+        cerr << "Error in opening file - " << traceFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start_time = chrono::steady_clock::now();
+    const vector<TraceEntry> trace_contents = trace.parseTraceFile(options.n_threads);
+    sweep.run(trace_contents, traceFileName, options.n_threads, options.sample_fraction, options.policy_kind, options.inclusion);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    sweep.printResults();
+    cerr << "[sweep] " << sweep.getConfigCount() << " configurations, " << trace_contents.size() << " accesses, "
+         << options.n_threads << " threads: " << fixed << setprecision(2) << elapsed << " s" << endl;
+    return 0;
+}
+
+
+/*
+ * @brief Profiles the stack distances of the trace once and prints the miss ratio curves of all requested L1 caches
+ */
+int runMissRatioCurves(uint blocksize, string traceFileName, SimulatorOptions& options)
+{
+    if(blocksize == 0 || (blocksize & (blocksize - 1)) != 0)
+    {
+        cout << "Invalid arguments" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Set counts needed by the (size, assoc) pairs that make a valid cache
+    vector<uint> set_counts;
+    uint max_assoc = *max_element(options.mrc_assocs.begin(), options.mrc_assocs.end());
+    for(uint size : options.mrc_sizes)
+    {
+        for(uint assoc : options.mrc_assocs)
+        {
+            uint n_sets = size / (blocksize * assoc);
+            const char* reason = nullptr;
+            if(n_sets == 0)
+                reason = "more ways than blocks";
+            else if(n_sets * blocksize * assoc != size || (n_sets & (n_sets - 1)) != 0)
+                reason = "the set count is not a power of two";
+            if(reason != nullptr)
+            {
+                cerr << "[mrc] skipping " << size << " B / " << assoc << " ways: " << reason << endl;
+                continue;
+            }
+            if(find(set_counts.begin(), set_counts.end(), n_sets) == set_counts.end()) set_counts.push_back(n_sets);
+        }
+    }
+
+    string traceFilePath = findTracePath(traceFileName);
+    Trace trace(traceFilePath, options.trace_format, options.isIFetchIncluded);
+    if(!trace.isOpen())
+    {
+        cerr << "Error in opening file - " << traceFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start_time = chrono::steady_clock::now();
+    StackDistanceProfiler profiler(blocksize, set_counts, max_assoc);
+    ProgressReporter progress(options.isProgressEnabled || trace.isStreamed());
+
+    vector<TraceEntry> batch(TRACE_BATCH_SIZE);
+    size_t n_entries;
+    while((n_entries = trace.readBatch(batch.data(), batch.size())) > 0)
+    {
+        profiler.sendRequests(batch.data(), n_entries);
+        progress.update(n_entries);
+    }
+    progress.finish();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    // Same rows as the plot scripts: every size with every associativity, then fully associative
+    double miss_penalty = CacheSimulator::findMissPenalty(blocksize);
+    cout << "l1_size,l1_assoc,n_sets,miss_rate,average_access_time" << endl;
+    cout << fixed << setprecision(4) << dec;
+
+    for(uint size : options.mrc_sizes)
+    {
+        vector<pair<uint, double>> assoc_miss_ratios;
+        for(uint assoc : options.mrc_assocs)
+        {
+            uint n_sets = size / (blocksize * assoc);
+            if(find(set_counts.begin(), set_counts.end(), n_sets) == set_counts.end() || n_sets * blocksize * assoc != size) continue;
+            assoc_miss_ratios.push_back(make_pair(assoc, profiler.getMissRatio(n_sets, assoc)));
+        }
+        if(size / blocksize > 0) assoc_miss_ratios.push_back(make_pair(size / blocksize, profiler.getFAMissRatio(size / blocksize)));
+
+        for(auto& assoc_miss_ratio : assoc_miss_ratios)
+        {
+            float hitTime, energy, area;
+            Cache::findCactiResults(size, blocksize, assoc_miss_ratio.first, hitTime, energy, area);
+
+            cout << size << "," << assoc_miss_ratio.first << "," << size / (blocksize * assoc_miss_ratio.first) << ","
+                 << assoc_miss_ratio.second << "," << hitTime + assoc_miss_ratio.second * miss_penalty << endl;
+        }
+    }
+
+    cerr << "[mrc] " << profiler.getAccessCount() << " block accesses, " << set_counts.size() << " set counts: "
+         << fixed << setprecision(2) << elapsed << " s" << endl;
+    return 0;
+}
+
+
+/*
+ * @brief Prints approximate LRU miss ratios of all requested cache sizes from a SHARDS pass in bounded memory
+ */
+int runSampledMissRatioCurves(uint blocksize, string traceFileName, SimulatorOptions& options)
+{
+    if(blocksize == 0 || (blocksize & (blocksize - 1)) != 0)
+    {
+        cout << "Invalid arguments" << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<uint> sizes = options.mrc_sizes;
+    sort(sizes.begin(), sizes.end());
+    vector<uint64_t> capacities;
+    for(uint size : sizes) capacities.push_back(size / blocksize);
+
+    string traceFilePath = findTracePath(traceFileName);
+    Trace trace(traceFilePath, options.trace_format, options.isIFetchIncluded);
+    if(!trace.isOpen())
+    {
+        cerr << "Error in opening file - " << traceFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start_time = chrono::steady_clock::now();
+    ShardsProfiler profiler(blocksize, capacities, options.memory_budget_mb * 1024 * 1024);
+    ProgressReporter progress(options.isProgressEnabled || trace.isStreamed());
+
+    vector<TraceEntry> batch(TRACE_BATCH_SIZE);
+    size_t n_entries;
+    while((n_entries = trace.readBatch(batch.data(), batch.size())) > 0)
+    {
+        profiler.sendRequests(batch.data(), n_entries);
+        progress.update(n_entries);
+    }
+    progress.finish();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    cout << "cache_size,n_blocks,miss_rate,std_error" << endl;
+    cout << fixed << setprecision(4) << dec;
+    for(size_t k = 0; k < sizes.size(); k++)
+    {
+        double miss_ratio, std_error;
+        profiler.getMissRatio(k, miss_ratio, std_error);
+        cout << sizes[k] << "," << capacities[k] << "," << miss_ratio << "," << std_error << endl;
+    }
+
+    cerr << "[shards] " << profiler.getAccessCount() << " block accesses, sampling rate " << fixed << setprecision(6)
+         << profiler.getSamplingRate() << " (" << profiler.getSampledBlockCount() << " blocks per sampler, "
+         << SHARDS_REPLICAS << " samplers): " << setprecision(2) << elapsed << " s" << endl;
+    return 0;
+}
+
+
+/*
+ * @brief Simulates an L2 of the given geometry behind the L1 (+VC) whose requests were recorded in the filter trace
+ */
+int runFilterTraceReplay(string filterTracePath, uint l2_size, uint l2_assoc)
+{
+    FilterTraceReader reader(filterTracePath);
+    if(!reader.isOpen())
+    {
+        cerr << "Error in opening file - " << filterTracePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    const FilterTraceHeader& header = reader.getHeader();
+    CacheSimulator cache_sim(header.l1_size, header.l1_assoc, header.l1_blocksize, header.n_vc_blocks, l2_size, l2_assoc, filterTracePath);
+    cache_sim.replayFilterTrace(reader);
+
+    cache_sim.printSimulatorConfiguration();
+    cache_sim.printCacheContents();
+    cache_sim.getSimulationStats().printStats();
+    return 0;
+}
+
+
+/*
+ * @brief Fills the CACTI memo table with every cache geometry of a sweep config file
+ */
+int runCactiPopulation(string configFilePath, SimulatorOptions& options)
+{
+    SweepEngine sweep;
+    if(!sweep.readConfigs(configFilePath))
+    {
+        cerr << "Error in opening file - " << configFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    // (size, block size, associativity) of every cache the configurations build
+    vector<tuple<uint, uint, uint>> geometries;
+    for(const SweepConfig& config : sweep.getConfigs())
+    {
+        geometries.push_back(make_tuple(config.l1_size, config.l1_blocksize, config.l1_assoc));
+        if(config.n_vc_blocks > 0) geometries.push_back(make_tuple(config.n_vc_blocks * config.l1_blocksize, config.l1_blocksize, config.n_vc_blocks));
+        if(config.l2_size > 0) geometries.push_back(make_tuple(config.l2_size, config.l1_blocksize, config.l2_assoc));
+    }
+
+    auto start_time = chrono::steady_clock::now();
+    size_t n_runs = CactiMemo::getInstance().populate(geometries, options.n_threads);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    cerr << "[cacti] " << geometries.size() << " geometries, " << n_runs << " CACTI runs on " << options.n_threads
+         << " threads: " << fixed << setprecision(2) << elapsed << " s" << endl;
+    return 0;
+}
+
 
 int main(int argc, char* argv[])
 {
     uint l1_size, l1_assoc, l1_blocksize, n_vc_blocks, l2_size, l2_assoc;
     string traceFileName;
+    SimulatorOptions options;
     // cout << argc << endl;
 
-    if(argc == 8)
+    if(argc >= 4 && strcmp(argv[1], "--sweep") == 0)
+    {
+        if(!options.parse(argc, argv, 4))
+        {
+            cout << "Invalid arguments" << endl;
+            return EXIT_FAILURE;
+        }
+        return runSweep(argv[2], argv[3], options);
+    }
+
+    if(argc >= 4 && strcmp(argv[1], "--mrc") == 0)
+    {
+        if(!options.parse(argc, argv, 4))
+        {
+            cout << "Invalid arguments" << endl;
+            return EXIT_FAILURE;
+        }
+        return runMissRatioCurves(atoi(argv[2]), argv[3], options);
+    }
+
+    if(argc >= 4 && strcmp(argv[1], "--shards") == 0)
+    {
+        if(!options.parse(argc, argv, 4))
+        {
+            cout << "Invalid arguments" << endl;
+            return EXIT_FAILURE;
+        }
+        return runSampledMissRatioCurves(atoi(argv[2]), argv[3], options);
+    }
+
+    if(argc >= 3 && strcmp(argv[1], "--cacti") == 0)
+    {
+        if(!options.parse(argc, argv, 3))
+        {
+            cout << "Invalid arguments" << endl;
+            return EXIT_FAILURE;
+        }
+        return runCactiPopulation(argv[2], options);
+    }
+
+    if(argc == 5 && strcmp(argv[1], "--replay-l2") == 0)
+    {
+        return runFilterTraceReplay(argv[2], atoi(argv[3]), atoi(argv[4]));
+    }
+
+    if(argc >= 8 && options.parse(argc, argv, 8))
     {
         l1_size = atoi(argv[1]);
         l1_assoc = atoi(argv[2]);
@@ -22,51 +512,143 @@ int main(int argc, char* argv[])
         l2_assoc = atoi(argv[6]);
         traceFileName = argv[7];
 
-        CacheSimulator cache_sim = CacheSimulator(l1_size, l1_assoc, l1_blocksize, n_vc_blocks, l2_size, l2_assoc, traceFileName);
-
-        string traceFilePath = TRACE_DIR_PATH + traceFileName;
-        ifstream traceFile(traceFilePath);
-
-        if(traceFile.is_open())
-        {
-            while(true)
-            {
-                string s1, s2;
-                traceFile >> s1 >> s2;
-
-                if(traceFile.fail() && !traceFile.eof())
-                {
-                    cerr << "Invalid input or formatting in trace file" << endl;
-                    exit(EXIT_FAILURE);
-                }
-                else if(traceFile.eof())
-                {
-                    break;
-                }
-
-                if(s1 == "r")
-                {
-                    long long int addr = std::stoll(s2, nullptr, 16);
-                    // cout << "r " << hex << addr << endl;
-                    cache_sim.sendReadRequest(addr);
-                }
-                else if(s1 == "w")
-                {
-                    long long int addr = std::stoll(s2, nullptr, 16);
-                    cache_sim.sendWriteRequest(addr);
-                }
-                else
-                {
-                    cerr << "Invalid input or formatting in trace file" << endl;
-                    exit(EXIT_FAILURE);                
-                }
+        vector<LevelGeometry> deeper_levels = options.getDeeperLevels();
+        if(!deeper_levels.empty() && l2_size == 0)
+        {
+            cerr << "--l3 / --l4 need an L2" << endl;
+            return EXIT_FAILURE;
+        }
+        if(options.sample_fraction < 1 && !deeper_levels.empty())
+        {
+            cerr << "--sample estimates L1 / L2 hierarchies only" << endl;
+            return EXIT_FAILURE;
+        }
+        if(options.sample_fraction < 1 && n_vc_blocks > 0)
+        {
+            cerr << "--sample needs VC_NUM_BLOCKS 0 (the victim cache is shared by every L1 set)" << endl;
+            return EXIT_FAILURE;
+        }
+        if(!options.filter_trace_path.empty() && options.inclusion != InclusionPolicy::NINE)
+        {
+            cerr << "--record-l2 needs --inclusion=nine (the filter trace holds the L1 writebacks only)" << endl;
+            return EXIT_FAILURE;
+        }
+        if(!options.filter_trace_path.empty() && options.simpoint_interval > 0)
+        {
+            cerr << "--record-l2 needs every access simulated, not with --simpoint" << endl;
+            return EXIT_FAILURE;
+        }
+
+        CacheSimulator cache_sim = CacheSimulator(l1_size, l1_assoc, l1_blocksize, n_vc_blocks, l2_size, l2_assoc, traceFileName,
+                                                  options.policy_kind, options.inclusion, deeper_levels);
+        const MetadataArena& arena = cache_sim.getMetadataArena();
+        cerr << "[arena] " << fixed << setprecision(1) << arena.getMappedBytes() / 1048576.0 << " MB of cache metadata, "
+             << (arena.isHugeTLBBacked() ? "MAP_HUGETLB 2 MB pages" : "transparent huge pages")
+             << " (MAP_HUGETLB up to " << ARENA_HUGETLB_MAX_BYTES / 1048576 << " MB)" << endl;
+        cerr << "[tag-match] " << getTagMatchKernelName() << " tag compare" << endl;
+        cache_sim.setPrefetchDistance(options.prefetch_distance);
+        if(options.isPCStatsEnabled) cache_sim.enablePCStatistics();
+        if(options.sample_fraction < 1) cache_sim.enableSetSampling(options.sample_fraction);
+        if(!options.filter_trace_path.empty() && !cache_sim.recordFilterTrace(options.filter_trace_path))
+        {
+            cerr << "Error in opening file - " << options.filter_trace_path << endl;
+            return EXIT_FAILURE;
+        }
+
+        string traceFilePath = findTracePath(traceFileName);
+
+        Trace trace(traceFilePath, options.trace_format, options.isIFetchIncluded);
+        ProgressReporter progress(options.isProgressEnabled || trace.isStreamed());
+        SimPointSampler simpoint_sampler(options.simpoint_interval, options.simpoint_clusters, l1_blocksize);
+
+        // Set sampling and SimPoint read the lower level counters between accesses: the levels then stay on this thread
+        bool isLevelPipelined = options.isLevelPipelined;
+        if(isLevelPipelined)
+        {
+            string reason;
+            if(l2_size == 0)
+                reason = "no level below L1";
+            else if(options.inclusion != InclusionPolicy::NINE)
+                reason = "inclusive / exclusive levels change the levels above";
+            else if(options.sample_fraction < 1)
+                reason = "--sample reads the L2 counters between accesses";
+            else if(options.simpoint_interval > 0)
+                reason = "--simpoint reads the L2 counters between intervals";
+            else if(options.isSetParallel)
+                reason = "--set-threads splits the sets instead";
+
+            if(!reason.empty())
+            {
+                cerr << "[level-threads] " << reason << ": simulating sequentially" << endl;
+                isLevelPipelined = false;
             }
         }
+        if(isLevelPipelined) cache_sim.startLevelThreads();
+
+        if(trace.isOpen() && options.simpoint_interval > 0)
+        {
+            if(trace.isStreamed() || options.sample_fraction < 1)
+            {
+                cerr << "--simpoint needs a trace file that can be read twice, without --sample" << endl;
+                return EXIT_FAILURE;
+            }
+
+            simpoint_sampler.profile(trace);
+            simpoint_sampler.findSimulationPoints();
+
+            Trace simulation_trace(traceFilePath, options.trace_format, options.isIFetchIncluded);
+            simpoint_sampler.simulate(simulation_trace, cache_sim);
+        }
+        else if(trace.isOpen() && options.isSetParallel)
+        {
+            if(n_vc_blocks > 0) cerr << "[set-threads] the victim cache is shared by all sets: simulating sequentially" << endl;
+
+            vector<TraceEntry> trace_contents = trace.parseTraceFile(options.n_threads);
+            cache_sim.sendRequestsSetPartitioned(trace_contents.data(), trace_contents.size(), options.n_threads);
+        }
+        else if(trace.isOpen() && options.isPipelined)
+        {
+            TracePipeline pipeline;
+            pipeline.run(trace, cache_sim, progress);
+            progress.finish();
+            pipeline.getPipelineStats().printStats();
+        }
+        else if(trace.isOpen() && (trace.getFormat() != TraceFormat::TEXT || trace.isStreamed()))
+        {
+            // Streams, binary records, compressed blocks and foreign formats are decoded batch by batch instead of holding the whole trace
+            vector<TraceEntry> batch(TRACE_BATCH_SIZE);
+            size_t n_entries;
+
+            while((n_entries = trace.readBatch(batch.data(), batch.size())) > 0)
+            {
+                cache_sim.sendRequests(batch.data(), n_entries);
+                progress.update(n_entries);
+            }
+            progress.finish();
+        }
+        else if(trace.isOpen())
+        {
+            vector<TraceEntry> trace_contents = trace.parseTraceFile(thread::hardware_concurrency());
+
+            for(size_t i = 0; i < trace_contents.size(); i += TRACE_BATCH_SIZE)
+            {
+                size_t n_entries = min<size_t>(TRACE_BATCH_SIZE, trace_contents.size() - i);
+                cache_sim.sendRequests(trace_contents.data() + i, n_entries);
+                progress.update(n_entries);
+            }
+            progress.finish();
+        }
         else
         {
             cerr << "Error in opening file - " << traceFilePath << endl;
         }
 
+        if(isLevelPipelined) cache_sim.finishLevelThreads();
+        if(!options.filter_trace_path.empty() && !cache_sim.closeFilterTrace())
+        {
+            cerr << "Error in writing file - " << options.filter_trace_path << endl;
+        }
+
         SimulationStatistics cache_sim_stats = cache_sim.getSimulationStats();
 
         cache_sim.printSimulatorConfiguration();
@@ -74,6 +656,9 @@ int main(int argc, char* argv[])
         
         SimulationStatistics sim_stats = cache_sim.getSimulationStats();
         sim_stats.printStats();
+        if(options.isPCStatsEnabled) cache_sim.printPCStatistics(PC_STATS_TOP);
+        cache_sim.printSetSamplingStatistics();
+        if(options.simpoint_interval > 0) simpoint_sampler.printSimulationPoints();
         // cout << "\nL1 Miss rate " << sim_stats.raw_stats.l1_vc_miss_rate << endl;
         // cout << "\nAAT " << sim_stats.perf_stats.average_access_time << endl;
         // cout << "EDP " << sim_stats.perf_stats.energy_delay_product << endl;
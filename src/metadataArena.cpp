@@ -0,0 +1,87 @@
+#include "metadataArena.h"
+#include<iostream>
+#include<cstdlib>
+#include<cstdint>
+#include<sys/mman.h>
+using namespace std;
+
+
+MetadataArena::MetadataArena()
+{
+    n_reservedBytes = 0;
+    n_mappedBytes = 0;
+    n_usedBytes = 0;
+    base = nullptr;
+    isHugeTLB = false;
+}
+
+
+MetadataArena::~MetadataArena()
+{
+    if(base != nullptr) munmap(base, n_mappedBytes);
+}
+
+
+void MetadataArena::reserve(size_t n_bytes)
+{
+    if(base != nullptr)
+    {
+        cerr << "Metadata arena: reserve after map" << endl;
+        exit(EXIT_FAILURE);
+    }
+    n_reservedBytes += n_bytes;
+}
+
+
+void MetadataArena::map()
+{
+    if(base != nullptr || n_reservedBytes == 0) return;
+    n_mappedBytes = (n_reservedBytes + ARENA_HUGE_PAGE_BYTES - 1) / ARENA_HUGE_PAGE_BYTES * ARENA_HUGE_PAGE_BYTES;
+
+    // Explicit huge pages are taken from the pool when mapped: this fails unless the pool holds the whole region,
+    // and is only tried for small regions (see ARENA_HUGETLB_MAX_BYTES)
+    if(n_mappedBytes <= ARENA_HUGETLB_MAX_BYTES)
+    {
+        void* region = mmap(nullptr, n_mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        isHugeTLB = region != MAP_FAILED;
+        if(isHugeTLB)
+        {
+            base = (char*) region;
+            return;
+        }
+    }
+
+    // Else one more huge page of address space, so that the region can start on a huge page boundary
+    size_t n_regionBytes = n_mappedBytes + ARENA_HUGE_PAGE_BYTES;
+    void* region = mmap(nullptr, n_regionBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(region == MAP_FAILED)
+    {
+        cerr << "Metadata arena: cannot map " << n_mappedBytes << " bytes" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    uintptr_t start = (uintptr_t) region;
+    uintptr_t aligned = (start + ARENA_HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE_BYTES - 1);
+    if(aligned > start) munmap(region, aligned - start);
+    if(aligned + n_mappedBytes < start + n_regionBytes) munmap((void*)(aligned + n_mappedBytes), start + n_regionBytes - aligned - n_mappedBytes);
+    base = (char*) aligned;
+    madvise(base, n_mappedBytes, MADV_HUGEPAGE);
+}
+
+
+void* MetadataArena::allocate(size_t n_bytes, size_t alignment)
+{
+    size_t offset = n_usedBytes.load(memory_order_relaxed);
+    size_t start;
+    do
+    {
+        start = (offset + alignment - 1) & ~(alignment - 1);
+    } while(!n_usedBytes.compare_exchange_weak(offset, start + n_bytes, memory_order_relaxed));
+
+    if(base == nullptr || start + n_bytes > n_mappedBytes)
+    {
+        cerr << "Metadata arena: " << n_bytes << " bytes more than reserved" << endl;
+        exit(EXIT_FAILURE);
+    }
+    return base + start;
+}
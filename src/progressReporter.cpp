@@ -0,0 +1,38 @@
+#include "progressReporter.h"
+#include<iomanip>
+
+ProgressReporter::ProgressReporter(bool isEnabled)
+{
+    this->isEnabled = isEnabled;
+    start_time = chrono::steady_clock::now();
+    last_report_time = start_time;
+    n_accesses = 0;
+    n_last_report_accesses = 0;
+}
+
+
+void ProgressReporter::report(chrono::steady_clock::time_point now)
+{
+    double elapsed = chrono::duration<double>(now - start_time).count();
+    double interval = chrono::duration<double>(now - last_report_time).count();
+    double rate = (interval > 0) ? (n_accesses - n_last_report_accesses) / interval : 0;
+
+    cerr << "[progress] " << dec << n_accesses << " accesses in " << fixed << setprecision(1) << elapsed << " s ("
+         << setprecision(2) << rate / 1e6 << " M accesses/s)" << endl;
+
+    last_report_time = now;
+    n_last_report_accesses = n_accesses;
+}
+
+
+void ProgressReporter::finish()
+{
+    if(!isEnabled) return;
+
+    auto now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - start_time).count();
+    double rate = (elapsed > 0) ? n_accesses / elapsed : 0;
+
+    cerr << "[progress] done: " << dec << n_accesses << " accesses in " << fixed << setprecision(1) << elapsed << " s ("
+         << setprecision(2) << rate / 1e6 << " M accesses/s)" << endl;
+}
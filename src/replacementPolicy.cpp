@@ -0,0 +1,228 @@
+#include "replacementPolicy.h"
+#include<algorithm>
+#include<numeric>
+
+bool parseReplacementPolicy(const string& name, ReplacementPolicyKind& kind)
+{
+    static const pair<const char*, ReplacementPolicyKind> policy_names[] =
+    {
+        {"lru", ReplacementPolicyKind::LRU},
+        {"plru", ReplacementPolicyKind::TREE_PLRU},
+        {"srrip", ReplacementPolicyKind::SRRIP},
+        {"brrip", ReplacementPolicyKind::BRRIP},
+        {"fifo", ReplacementPolicyKind::FIFO},
+        {"random", ReplacementPolicyKind::RANDOM}
+    };
+
+    for(auto& policy_name : policy_names)
+    {
+        if(name == policy_name.first)
+        {
+            kind = policy_name.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+const char* getReplacementPolicyName(ReplacementPolicyKind kind)
+{
+    switch(kind)
+    {
+        case ReplacementPolicyKind::LRU: return "lru";
+        case ReplacementPolicyKind::TREE_PLRU: return "plru";
+        case ReplacementPolicyKind::SRRIP: return "srrip";
+        case ReplacementPolicyKind::BRRIP: return "brrip";
+        case ReplacementPolicyKind::FIFO: return "fifo";
+        case ReplacementPolicyKind::RANDOM: return "random";
+    }
+    return "";
+}
+
+
+ReplacementPolicy makeReplacementPolicy(MetadataArena* arena, ReplacementPolicyKind kind, uint n_sets, uint assoc)
+{
+    switch(kind)
+    {
+        case ReplacementPolicyKind::TREE_PLRU: return TreePLRUPolicy(arena, n_sets, assoc);
+        case ReplacementPolicyKind::SRRIP: return RRIPPolicy(arena, n_sets, assoc, false);
+        case ReplacementPolicyKind::BRRIP: return RRIPPolicy(arena, n_sets, assoc, true);
+        case ReplacementPolicyKind::FIFO: return FIFOPolicy(arena, n_sets, assoc);
+        case ReplacementPolicyKind::RANDOM: return RandomPolicy(arena, n_sets, assoc);
+        default: return LRUPolicy(arena, n_sets, assoc);
+    }
+}
+
+
+/*
+ * @return ways 0 .. assoc - 1
+ */
+static vector<int> findWayOrder(uint assoc)
+{
+    vector<int> order(assoc);
+    iota(order.begin(), order.end(), 0);
+    return order;
+}
+
+
+/****************************
+*********** LRU *************
+****************************/
+
+LRUPolicy::LRUPolicy(MetadataArena* arena, uint n_sets, uint assoc)
+{
+    this->assoc = assoc;
+    isListed = assoc >= FA_ENGINE_MIN_ASSOC;
+
+    if(isListed)
+    {
+        lists = SetPageTable<int>(arena, n_sets, RecencyList::getRecordSize(assoc), [assoc] (uint /* set_num */, int* record)
+        {
+            RecencyList::initRecord(record, assoc);
+        });
+        return;
+    }
+
+    // Way j starts with counter j
+    counters = SetPageTable<int>(arena, n_sets, assoc, [assoc] (uint /* set_num */, int* set_counters)
+    {
+        iota(set_counters, set_counters + assoc, 0);
+    });
+}
+
+
+vector<int> LRUPolicy::getOrder(int set_num)
+{
+    if(isListed) return getList(set_num).getRecencyOrder();
+
+    vector<int> order = findWayOrder(assoc);
+    const int* set_counters = counters.getSet(set_num);
+    sort(order.begin(), order.end(), [set_counters] (int a, int b) {return set_counters[a] < set_counters[b];});
+    return order;
+}
+
+
+void LRUPolicy::copySet(const LRUPolicy& other, int set_num)
+{
+    if(isListed)
+        lists.copySet(other.lists, set_num);
+    else
+        counters.copySet(other.counters, set_num);
+}
+
+
+/****************************
+********* TREE PLRU *********
+****************************/
+
+TreePLRUPolicy::TreePLRUPolicy(MetadataArena* arena, uint n_sets, uint assoc)
+{
+    this->assoc = assoc;
+    n_leaves = 1;
+    while(n_leaves < assoc) n_leaves *= 2;
+    n_words = (n_leaves + 63) / 64;
+    node_bits = SetPageTable<uint64_t>(arena, n_sets, n_words);
+}
+
+
+vector<int> TreePLRUPolicy::getOrder(int /* set_num */)
+{
+    return findWayOrder(assoc);
+}
+
+
+void TreePLRUPolicy::copySet(const TreePLRUPolicy& other, int set_num)
+{
+    node_bits.copySet(other.node_bits, set_num);
+}
+
+
+/****************************
+*********** RRIP ************
+****************************/
+
+RRIPPolicy::RRIPPolicy(MetadataArena* arena, uint n_sets, uint assoc, bool isBimodal)
+{
+    this->assoc = assoc;
+    this->isBimodal = isBimodal;
+    rrpvs = SetPageTable<uint8_t>(arena, n_sets, assoc, [assoc] (uint /* set_num */, uint8_t* set_rrpvs)
+    {
+        fill_n(set_rrpvs, assoc, RRIP_MAX_RRPV);
+    });
+    fill_counts = SetPageTable<uint8_t>(arena, n_sets, 1);
+}
+
+
+vector<int> RRIPPolicy::getOrder(int set_num)
+{
+    // Nearest predicted re-reference first
+    vector<int> order = findWayOrder(assoc);
+    const uint8_t* set_rrpvs = rrpvs.getSet(set_num);
+    stable_sort(order.begin(), order.end(), [set_rrpvs] (int a, int b) {return set_rrpvs[a] < set_rrpvs[b];});
+    return order;
+}
+
+
+void RRIPPolicy::copySet(const RRIPPolicy& other, int set_num)
+{
+    rrpvs.copySet(other.rrpvs, set_num);
+    fill_counts.copySet(other.fill_counts, set_num);
+}
+
+
+/****************************
+*********** FIFO ************
+****************************/
+
+FIFOPolicy::FIFOPolicy(MetadataArena* arena, uint n_sets, uint assoc)
+{
+    this->assoc = assoc;
+    next_victims = SetPageTable<uint>(arena, n_sets, 1);
+}
+
+
+vector<int> FIFOPolicy::getOrder(int set_num)
+{
+    // Newest fill first: the ways before the fill pointer, going backwards
+    uint next_victim = *next_victims.getSet(set_num);
+    vector<int> order;
+    for(uint i = 1; i <= assoc; i++) order.push_back((next_victim + assoc - i) % assoc);
+    return order;
+}
+
+
+void FIFOPolicy::copySet(const FIFOPolicy& other, int set_num)
+{
+    next_victims.copySet(other.next_victims, set_num);
+}
+
+
+/****************************
+********** RANDOM ***********
+****************************/
+
+RandomPolicy::RandomPolicy(MetadataArena* arena, uint n_sets, uint assoc)
+{
+    this->assoc = assoc;
+    states = SetPageTable<uint64_t>(arena, n_sets, 1, [] (uint set_num, uint64_t* set_state)
+    {
+        // splitmix64 of (seed, set): a non-zero xorshift state per set
+        uint64_t state = ((uint64_t) REPLACEMENT_SEED << 32 | set_num) + 0x9e3779b97f4a7c15ULL;
+        state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        state = (state ^ (state >> 27)) * 0x94d049bb133111ebULL;
+        *set_state = (state ^ (state >> 31)) | 1;
+    });
+}
+
+
+vector<int> RandomPolicy::getOrder(int /* set_num */)
+{
+    return findWayOrder(assoc);
+}
+
+
+void RandomPolicy::copySet(const RandomPolicy& other, int set_num)
+{
+    states.copySet(other.states, set_num);
+}
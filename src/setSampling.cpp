@@ -0,0 +1,92 @@
+#include "setSampling.h"
+#include<algorithm>
+#include<numeric>
+#include<random>
+#include<cmath>
+
+SetSampler::SetSampler(uint n_groups, uint block_size, double fraction)
+{
+    this->n_groups = n_groups;
+    n_blockOffsetBits = log2(block_size);
+
+    // At least two groups (one cannot give a variance), unless the cache has a single set
+    uint n_sampled = (uint) llround(fraction * n_groups);
+    n_sampled = min(n_groups, max<uint>(n_sampled, 2));
+
+    vector<uint> groups(n_groups);
+    iota(groups.begin(), groups.end(), 0);
+    mt19937 rng(SET_SAMPLING_SEED);
+    shuffle(groups.begin(), groups.end(), rng);
+
+    sampled_groups.assign(groups.begin(), groups.begin() + n_sampled);
+    sort(sampled_groups.begin(), sampled_groups.end());
+
+    isGroupSampled.assign(n_groups, false);
+    for(uint group : sampled_groups) isGroupSampled[group] = true;
+    group_counters.assign(n_groups, SetGroupCounters());
+}
+
+
+void SetSampler::recordAccess(long long int addr, const SetGroupCounters& totals)
+{
+    SetGroupCounters& counters = group_counters[((uint64_t) addr >> n_blockOffsetBits) & (n_groups - 1)];
+    counters.n_accesses += totals.n_accesses - last_totals.n_accesses;
+    counters.n_misses += totals.n_misses - last_totals.n_misses;
+    counters.n_swap_requests += totals.n_swap_requests - last_totals.n_swap_requests;
+    counters.n_l2_read_misses += totals.n_l2_read_misses - last_totals.n_l2_read_misses;
+    last_totals = totals;
+}
+
+
+template<typename Numerator, typename Denominator>
+SampledEstimate SetSampler::estimateRatio(Numerator value, Denominator weight)
+{
+    double value_sum = 0, weight_sum = 0;
+    for(uint group : sampled_groups)
+    {
+        value_sum += value(group_counters[group]);
+        weight_sum += weight(group_counters[group]);
+    }
+
+    SampledEstimate estimate = {0, 0};
+    size_t n = sampled_groups.size();
+    if(weight_sum == 0) return estimate;
+    estimate.value = value_sum / weight_sum;
+    if(n < 2) return estimate;
+
+    // Variance of a ratio estimator under cluster sampling (with the finite population correction)
+    double squared_residuals = 0;
+    for(uint group : sampled_groups)
+    {
+        double residual = value(group_counters[group]) - estimate.value * weight(group_counters[group]);
+        squared_residuals += residual * residual;
+    }
+    double mean_weight = weight_sum / n;
+    double variance = (1 - (double) n / n_groups) * squared_residuals / ((n - 1) * n * mean_weight * mean_weight);
+    estimate.half_width = SET_SAMPLING_Z * sqrt(variance);
+    return estimate;
+}
+
+
+SampledEstimate SetSampler::estimateMissRate()
+{
+    return estimateRatio([] (const SetGroupCounters& c) {return (double) c.n_misses;},
+                         [] (const SetGroupCounters& c) {return (double) c.n_accesses;});
+}
+
+
+SampledEstimate SetSampler::estimateL2MissRate()
+{
+    return estimateRatio([] (const SetGroupCounters& c) {return (double) c.n_l2_read_misses;},
+                         [] (const SetGroupCounters& c) {return (double) c.n_misses;});
+}
+
+
+SampledEstimate SetSampler::estimateAAT(double l1_hit_time, double vc_hit_time, double l1_miss_time, double l2_miss_time)
+{
+    SampledEstimate estimate = estimateRatio(
+        [=] (const SetGroupCounters& c) {return c.n_swap_requests * vc_hit_time + c.n_misses * l1_miss_time + c.n_l2_read_misses * l2_miss_time;},
+        [] (const SetGroupCounters& c) {return (double) c.n_accesses;});
+    estimate.value += l1_hit_time;
+    return estimate;
+}
@@ -0,0 +1,136 @@
+#include "shards.h"
+#include<algorithm>
+#include<cmath>
+
+/****************************
+ ****** SHARDS SAMPLER ******
+****************************/
+
+ShardsSampler::ShardsSampler(uint64_t salt, size_t max_blocks, const vector<uint64_t>& capacities)
+    : stack(2 * max_blocks)
+{
+    this->salt = salt;
+    threshold = 1 << SHARDS_HASH_BITS;  // everything is sampled until the budget is reached
+    this->max_blocks = max<size_t>(max_blocks, 1);
+    this->capacities = capacities;
+    bucket_hits.assign(capacities.size() + 1, 0);
+    n_sampled = 0;
+}
+
+
+uint32_t ShardsSampler::hashBlock(uint64_t block)
+{
+    // splitmix64 finalizer
+    uint64_t hash = block ^ salt;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash = hash ^ (hash >> 31);
+    return hash >> (64 - SHARDS_HASH_BITS);
+}
+
+
+void ShardsSampler::lowerThreshold()
+{
+    uint32_t new_threshold = sampled_blocks.rbegin()->first;
+
+    while(!sampled_blocks.empty() && sampled_blocks.rbegin()->first >= new_threshold)
+    {
+        stack.remove(sampled_blocks.rbegin()->second);
+        sampled_blocks.erase(prev(sampled_blocks.end()));
+    }
+
+    // Counts so far were gathered at the old rate
+    double scale = (double) new_threshold / threshold;
+    for(double& hits : bucket_hits) hits *= scale;
+    n_sampled *= scale;
+    threshold = new_threshold;
+}
+
+
+void ShardsSampler::accessBlock(uint64_t block)
+{
+    uint32_t hash = hashBlock(block);
+    if(hash >= threshold) return;
+
+    n_sampled++;
+
+    uint64_t distance;
+    if(stack.access(block, distance))
+    {
+        double scaled_distance = distance / getSamplingRate();
+        size_t k = upper_bound(capacities.begin(), capacities.end(), scaled_distance) - capacities.begin();
+        bucket_hits[k]++;   // hits in caches capacities[k..]
+    }
+    else
+    {
+        sampled_blocks.insert(make_pair(hash, block));
+        if(sampled_blocks.size() > max_blocks) lowerThreshold();
+    }
+}
+
+
+double ShardsSampler::getMissRatio(size_t k, uint64_t n_accesses)
+{
+    double n_expected = n_accesses * getSamplingRate();
+    if(n_expected <= 0) return 0;
+
+    double n_hits = 0;
+    for(size_t i = 0; i <= k; i++) n_hits += bucket_hits[i];
+
+    // SHARDS_adj: the sample holds more / fewer accesses than expected at this rate, the difference is
+    // accounted as distance 0 (a hit for every size)
+    n_hits += n_expected - n_sampled;
+
+    return min(1.0, max(0.0, 1 - n_hits / n_expected));
+}
+
+
+/****************************
+****** SHARDS PROFILER ******
+****************************/
+
+ShardsProfiler::ShardsProfiler(uint block_size, const vector<uint64_t>& capacities, size_t memory_budget)
+{
+    n_blockOffsetBits = log2(block_size);
+    n_accesses = 0;
+
+    size_t max_blocks = memory_budget / (SHARDS_REPLICAS * SHARDS_BYTES_PER_BLOCK);
+    for(uint i = 0; i < SHARDS_REPLICAS; i++)
+    {
+        uint64_t salt = 0x9e3779b97f4a7c15ULL * (i + 1);
+        samplers.push_back(ShardsSampler(salt, max_blocks, capacities));
+    }
+}
+
+
+void ShardsProfiler::sendRequests(const TraceEntry* entries, size_t n_entries)
+{
+    for(size_t i = 0; i < n_entries; i++)
+    {
+        uint64_t first_block = (uint64_t) entries[i].addr >> n_blockOffsetBits;
+        uint64_t last_block = first_block;
+        if(entries[i].size > 1) last_block = ((uint64_t) entries[i].addr + entries[i].size - 1) >> n_blockOffsetBits;
+
+        for(uint64_t block = first_block; block <= last_block; block++)
+        {
+            n_accesses++;
+            for(ShardsSampler& sampler : samplers) sampler.accessBlock(block);
+        }
+    }
+}
+
+
+void ShardsProfiler::getMissRatio(size_t k, double& miss_ratio, double& std_error)
+{
+    vector<double> estimates;
+    for(ShardsSampler& sampler : samplers) estimates.push_back(sampler.getMissRatio(k, n_accesses));
+
+    double sum = 0;
+    for(double estimate : estimates) sum += estimate;
+    miss_ratio = sum / estimates.size();
+
+    double squared_deviations = 0;
+    for(double estimate : estimates) squared_deviations += (estimate - miss_ratio) * (estimate - miss_ratio);
+    double variance = (estimates.size() > 1) ? squared_deviations / (estimates.size() - 1) : 0;
+    std_error = sqrt(variance / estimates.size());
+}
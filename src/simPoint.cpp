@@ -0,0 +1,253 @@
+#include "simPoint.h"
+#include<algorithm>
+#include<random>
+#include<cmath>
+#include<iomanip>
+
+SimPointSampler::SimPointSampler(uint64_t interval_length, uint n_clusters, uint block_size)
+{
+    this->interval_length = interval_length;
+    this->n_clusters = n_clusters;
+    n_blockOffsetBits = log2(block_size);
+}
+
+
+void SimPointSampler::addSignature(const vector<double>& block_counts, uint64_t n_accesses)
+{
+    vector<double> signature(SIMPOINT_DIMENSIONS);
+    for(uint d = 0; d < SIMPOINT_DIMENSIONS; d++) signature[d] = block_counts[d] / n_accesses;
+    signatures.push_back(signature);
+    interval_accesses.push_back(n_accesses);
+}
+
+
+double SimPointSampler::findDistance(const vector<double>& a, const vector<double>& b)
+{
+    double distance = 0;
+    for(uint d = 0; d < SIMPOINT_DIMENSIONS; d++) distance += (a[d] - b[d]) * (a[d] - b[d]);
+    return distance;
+}
+
+
+void SimPointSampler::profile(Trace& trace)
+{
+    vector<TraceEntry> batch(TRACE_BATCH_SIZE);
+    vector<double> block_counts(SIMPOINT_DIMENSIONS, 0);
+    uint64_t n_interval_accesses = 0;
+    size_t n_entries;
+
+    while((n_entries = trace.readBatch(batch.data(), batch.size())) > 0)
+    {
+        for(size_t i = 0; i < n_entries; i++)
+        {
+            // Reads and writes of a block count apart: write-only phases behave differently (dirty blocks, writebacks)
+            uint64_t block = (uint64_t) batch[i].addr >> n_blockOffsetBits;
+            uint64_t key = 2 * block + (batch[i].operation == 'w');
+            block_counts[((key * 0x9e3779b97f4a7c15ULL) >> 32) % SIMPOINT_DIMENSIONS]++;
+
+            if(++n_interval_accesses == interval_length)
+            {
+                addSignature(block_counts, n_interval_accesses);
+                fill(block_counts.begin(), block_counts.end(), 0);
+                n_interval_accesses = 0;
+            }
+        }
+    }
+    if(n_interval_accesses > 0) addSignature(block_counts, n_interval_accesses);
+}
+
+
+void SimPointSampler::findSimulationPoints()
+{
+    size_t n_intervals = signatures.size();
+    uint k = min<size_t>(n_clusters, n_intervals);
+    cluster_of.assign(n_intervals, 0);
+    if(k == 0) return;
+
+    // k-means++ seeding: next centroid drawn with probability proportional to the squared distance to the nearest one
+    mt19937 rng(SIMPOINT_SEED);
+    vector<vector<double>> centroids;
+    centroids.push_back(signatures[uniform_int_distribution<size_t>(0, n_intervals - 1)(rng)]);
+    vector<double> nearest_distances(n_intervals);
+    while(centroids.size() < k)
+    {
+        for(size_t i = 0; i < n_intervals; i++)
+        {
+            nearest_distances[i] = findDistance(signatures[i], centroids[0]);
+            for(size_t c = 1; c < centroids.size(); c++) nearest_distances[i] = min(nearest_distances[i], findDistance(signatures[i], centroids[c]));
+        }
+        double total_distance = 0;
+        for(double distance : nearest_distances) total_distance += distance;
+        if(total_distance == 0) break;  // fewer distinct signatures than clusters
+
+        discrete_distribution<size_t> pick(nearest_distances.begin(), nearest_distances.end());
+        centroids.push_back(signatures[pick(rng)]);
+    }
+
+    // Lloyd iterations
+    for(uint iteration = 0; iteration < SIMPOINT_MAX_ITERATIONS; iteration++)
+    {
+        bool isChanged = (iteration == 0);
+        for(size_t i = 0; i < n_intervals; i++)
+        {
+            uint nearest = 0;
+            for(uint c = 1; c < centroids.size(); c++)
+            {
+                if(findDistance(signatures[i], centroids[c]) < findDistance(signatures[i], centroids[nearest])) nearest = c;
+            }
+            if(nearest != cluster_of[i]) isChanged = true;
+            cluster_of[i] = nearest;
+        }
+        if(!isChanged) break;
+
+        vector<vector<double>> sums(centroids.size(), vector<double>(SIMPOINT_DIMENSIONS, 0));
+        vector<uint64_t> sizes(centroids.size(), 0);
+        for(size_t i = 0; i < n_intervals; i++)
+        {
+            for(uint d = 0; d < SIMPOINT_DIMENSIONS; d++) sums[cluster_of[i]][d] += signatures[i][d];
+            sizes[cluster_of[i]]++;
+        }
+        for(uint c = 0; c < centroids.size(); c++)
+        {
+            if(sizes[c] == 0) continue;     // empty cluster keeps its centroid
+            for(uint d = 0; d < SIMPOINT_DIMENSIONS; d++) centroids[c][d] = sums[c][d] / sizes[c];
+        }
+    }
+
+    // Simulation point of a cluster: its interval closest to the centroid, weighted by the accesses of the cluster
+    uint64_t n_accesses = 0;
+    for(uint64_t interval_access_count : interval_accesses) n_accesses += interval_access_count;
+
+    for(uint c = 0; c < centroids.size(); c++)
+    {
+        int64_t representative = -1;
+        uint64_t cluster_accesses = 0;
+        for(size_t i = 0; i < n_intervals; i++)
+        {
+            if(cluster_of[i] != c) continue;
+            cluster_accesses += interval_accesses[i];
+            // Ties go to the later interval, its caches are warmer (repeated phases look alike)
+            if(representative == -1 || findDistance(signatures[i], centroids[c]) <= findDistance(signatures[representative], centroids[c])) representative = i;
+        }
+        if(representative == -1) continue;
+
+        representatives.push_back(representative);
+        weights.push_back((double) cluster_accesses / n_accesses);
+    }
+}
+
+
+/*
+ * @brief Weighted sums of the event counters of one level
+ */
+struct WeightedCounters
+{
+    double n_reads = 0, n_read_misses = 0, n_writes = 0, n_write_misses = 0;
+    double n_swap_requests = 0, n_swaps = 0, n_writebacks = 0, n_back_invalidations = 0;
+
+    void add(const CacheStatistics& start, const CacheStatistics& end, double scale)
+    {
+        n_reads += scale * (end.n_reads - start.n_reads);
+        n_read_misses += scale * (end.n_read_misses - start.n_read_misses);
+        n_writes += scale * (end.n_writes - start.n_writes);
+        n_write_misses += scale * (end.n_write_misses - start.n_write_misses);
+        n_swap_requests += scale * (end.n_swap_requests - start.n_swap_requests);
+        n_swaps += scale * (end.n_swaps - start.n_swaps);
+        n_writebacks += scale * (end.n_writebacks - start.n_writebacks);
+        n_back_invalidations += scale * (end.n_back_invalidations - start.n_back_invalidations);
+    }
+
+    void store(CacheStatistics& stats)
+    {
+        stats.n_reads = llround(n_reads);
+        stats.n_read_misses = llround(n_read_misses);
+        stats.n_writes = llround(n_writes);
+        stats.n_write_misses = llround(n_write_misses);
+        stats.n_swap_requests = llround(n_swap_requests);
+        stats.n_swaps = llround(n_swaps);
+        stats.n_writebacks = llround(n_writebacks);
+        stats.n_back_invalidations = llround(n_back_invalidations);
+    }
+};
+
+
+void SimPointSampler::simulate(Trace& trace, CacheSimulator& cache_sim)
+{
+    // Interval -> index into representatives (-1: warming only)
+    vector<int> representative_of(signatures.size(), -1);
+    for(size_t r = 0; r < representatives.size(); r++) representative_of[representatives[r]] = r;
+
+    uint64_t n_accesses = 0;
+    for(uint64_t interval_access_count : interval_accesses) n_accesses += interval_access_count;
+
+    // A simulation point stands for the accesses of its whole cluster
+    double n_split_accesses = 0, n_split_requests = 0;
+    HierarchyCounters interval_start = cache_sim.getCounters();
+    vector<WeightedCounters> level_counts(interval_start.level_stats.size());
+    WeightedCounters vc_counts;
+
+    auto finishInterval = [&] (uint64_t interval, uint64_t n_interval_accesses)
+    {
+        HierarchyCounters interval_end = cache_sim.getCounters();
+        if(interval < representative_of.size() && representative_of[interval] != -1)
+        {
+            double scale = weights[representative_of[interval]] * n_accesses / n_interval_accesses;
+            for(size_t level = 0; level < level_counts.size(); level++)
+            {
+                level_counts[level].add(interval_start.level_stats[level], interval_end.level_stats[level], scale);
+            }
+            vc_counts.add(interval_start.vc_stats, interval_end.vc_stats, scale);
+            n_split_accesses += scale * (interval_end.n_split_accesses - interval_start.n_split_accesses);
+            n_split_requests += scale * (interval_end.n_split_requests - interval_start.n_split_requests);
+        }
+        interval_start = interval_end;
+    };
+
+    vector<TraceEntry> batch(TRACE_BATCH_SIZE);
+    size_t n_entries;
+    uint64_t interval = 0, n_interval_accesses = 0;
+
+    while((n_entries = trace.readBatch(batch.data(), batch.size())) > 0)
+    {
+        size_t i = 0;
+        while(i < n_entries)
+        {
+            // Rest of the current interval within this batch
+            size_t n_chunk = min<uint64_t>(n_entries - i, interval_length - n_interval_accesses);
+            bool isSimulationPoint = interval < representative_of.size() && representative_of[interval] != -1;
+            if(isSimulationPoint)
+                cache_sim.sendRequests(batch.data() + i, n_chunk);
+            else
+                cache_sim.warmRequests(batch.data() + i, n_chunk);
+            i += n_chunk;
+            n_interval_accesses += n_chunk;
+
+            if(n_interval_accesses == interval_length)
+            {
+                finishInterval(interval++, n_interval_accesses);
+                n_interval_accesses = 0;
+            }
+        }
+    }
+    if(n_interval_accesses > 0) finishInterval(interval, n_interval_accesses);
+
+    HierarchyCounters weighted = cache_sim.getCounters();
+    for(size_t level = 0; level < level_counts.size(); level++) level_counts[level].store(weighted.level_stats[level]);
+    vc_counts.store(weighted.vc_stats);
+    weighted.n_split_accesses = llround(n_split_accesses);
+    weighted.n_split_requests = llround(n_split_requests);
+    cache_sim.setCounters(weighted);
+}
+
+
+void SimPointSampler::printSimulationPoints()
+{
+    cout << endl;
+    cout << fixed << setprecision(4) << dec;
+    cout << "===== SimPoint (" << representatives.size() << " simulation points, " << signatures.size()
+         << " intervals of " << interval_length << " accesses) =====" << endl;
+    for(size_t r = 0; r < representatives.size(); r++)
+    {
+        cout << "  interval " << representatives[r] << ":\t\t" << weights[r] << endl;
+    }
+}
@@ -0,0 +1,147 @@
+#include "stackDistance.h"
+#include<algorithm>
+#include<cmath>
+#include<cstdlib>
+
+LRUStackDistance::LRUStackDistance(size_t min_positions)
+{
+    this->min_positions = max<size_t>(min_positions, 1);
+    live_positions.reset(this->min_positions);
+    next_position = 0;
+}
+
+
+void LRUStackDistance::compactPositions()
+{
+    vector<pair<uint64_t, uint64_t>> live_blocks;   // (position, block)
+    live_blocks.reserve(last_position.size());
+    for(auto& block_position : last_position) live_blocks.push_back(make_pair(block_position.second, block_position.first));
+    sort(live_blocks.begin(), live_blocks.end());
+
+    live_positions.reset(max<size_t>(min_positions, 2 * live_blocks.size()));
+    for(size_t i = 0; i < live_blocks.size(); i++)
+    {
+        last_position[live_blocks[i].second] = i;
+        live_positions.add(i, 1);
+    }
+    next_position = live_blocks.size();
+}
+
+
+bool LRUStackDistance::access(uint64_t block, uint64_t& distance)
+{
+    if(next_position == live_positions.size()) compactPositions();
+
+    auto inserted = last_position.emplace(block, next_position);
+    bool isReuse = !inserted.second;
+    if(isReuse)
+    {
+        // Blocks whose latest access lies between the two accesses of `block`
+        uint64_t previous_position = inserted.first->second;
+        distance = live_positions.prefixSum(next_position) - live_positions.prefixSum(previous_position + 1);
+
+        live_positions.add(previous_position, -1);
+        inserted.first->second = next_position;
+    }
+    live_positions.add(next_position, 1);
+    next_position++;
+    return isReuse;
+}
+
+
+void LRUStackDistance::remove(uint64_t block)
+{
+    auto block_position = last_position.find(block);
+    if(block_position == last_position.end()) return;
+
+    live_positions.add(block_position->second, -1);
+    last_position.erase(block_position);
+}
+
+
+StackDistanceProfiler::StackDistanceProfiler(uint block_size, const vector<uint>& set_counts, uint max_assoc)
+{
+    this->block_size = block_size;
+    n_blockOffsetBits = log2(block_size);
+    this->max_assoc = max_assoc;
+    n_accesses = 0;
+    n_cold_misses = 0;
+
+    for(uint n_sets : set_counts)
+    {
+        SetStacks set_stack;
+        set_stack.n_sets = n_sets;
+        set_stack.stacks.assign((size_t) n_sets * max_assoc, 0);
+        set_stack.depth_hits.assign(max_assoc, 0);
+        set_stacks.push_back(set_stack);
+    }
+}
+
+
+void StackDistanceProfiler::accessBlock(uint64_t block)
+{
+    n_accesses++;
+
+    // 1. Fully associative stack distance
+    uint64_t distance;
+    if(fa_stack.access(block, distance))
+    {
+        if(distance >= distance_histogram.size()) distance_histogram.resize(max<size_t>(2 * distance_histogram.size(), distance + 1), 0);
+        distance_histogram[distance]++;
+    }
+    else
+    {
+        n_cold_misses++;
+    }
+
+    // 2. Per-set LRU stacks: depth of the block in its set's stack, then move it to the front
+    for(SetStacks& set_stack : set_stacks)
+    {
+        uint64_t* stack = set_stack.stacks.data() + (size_t)(block & (set_stack.n_sets - 1)) * max_assoc;
+        uint depth = 0;
+        while(depth < max_assoc && stack[depth] != block + 1) depth++;
+
+        if(depth < max_assoc) set_stack.depth_hits[depth]++;
+        else depth = max_assoc - 1;    // miss: the LRU block falls off
+
+        for(uint i = depth; i > 0; i--) stack[i] = stack[i-1];
+        stack[0] = block + 1;
+    }
+}
+
+
+void StackDistanceProfiler::sendRequests(const TraceEntry* entries, size_t n_entries)
+{
+    for(size_t i = 0; i < n_entries; i++)
+    {
+        uint64_t first_block = (uint64_t) entries[i].addr >> n_blockOffsetBits;
+        uint64_t last_block = first_block;
+        if(entries[i].size > 1) last_block = ((uint64_t) entries[i].addr + entries[i].size - 1) >> n_blockOffsetBits;
+
+        for(uint64_t block = first_block; block <= last_block; block++) accessBlock(block);
+    }
+}
+
+
+double StackDistanceProfiler::getFAMissRatio(uint64_t n_blocks)
+{
+    uint64_t n_misses = n_cold_misses;
+    for(size_t distance = n_blocks; distance < distance_histogram.size(); distance++) n_misses += distance_histogram[distance];
+    return (double) n_misses / n_accesses;
+}
+
+
+double StackDistanceProfiler::getMissRatio(uint n_sets, uint assoc)
+{
+    for(SetStacks& set_stack : set_stacks)
+    {
+        if(set_stack.n_sets != n_sets) continue;
+
+        uint64_t n_hits = 0;
+        for(uint depth = 0; depth < min(assoc, max_assoc); depth++) n_hits += set_stack.depth_hits[depth];
+        return (double)(n_accesses - n_hits) / n_accesses;
+    }
+
+    cerr << "Set count " << n_sets << " was not profiled" << endl;
+    exit(EXIT_FAILURE);
+}
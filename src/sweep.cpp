@@ -0,0 +1,89 @@
+#include "sweep.h"
+#include "threadPool.h"
+#include<fstream>
+#include<sstream>
+#include<iomanip>
+#include<cstdlib>
+
+bool SweepEngine::readConfigs(string configFilePath)
+{
+    ifstream configFile(configFilePath);
+    if(!configFile.is_open()) return false;
+
+    string line;
+    size_t line_num = 0;
+    while(getline(configFile, line))
+    {
+        line_num++;
+        line = line.substr(0, line.find('#'));
+
+        istringstream fields(line);
+        string first_field;
+        if(!(fields >> first_field)) continue;  // blank line / comment
+        fields.seekg(0);
+
+        SweepConfig config;
+        string extra_field;
+        bool isValidLine = (fields >> config.l1_size >> config.l1_assoc >> config.l1_blocksize
+                                   >> config.n_vc_blocks >> config.l2_size >> config.l2_assoc) &&
+                           !(fields >> extra_field) &&
+                           config.l1_size > 0 && config.l1_assoc > 0 && config.l1_blocksize > 0 &&
+                           (config.l2_size == 0 || config.l2_assoc > 0);
+        if(!isValidLine)
+        {
+            cerr << "Invalid configuration in sweep file (Line: " << line_num << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+        configs.push_back(config);
+    }
+    return true;
+}
+
+
+void SweepEngine::run(const vector<TraceEntry>& trace_contents, string trace_file_name, uint n_threads, double sample_fraction,
+                      ReplacementPolicyKind policy_kind, InclusionPolicy inclusion)
+{
+    results.assign(configs.size(), SimulationStatistics());
+
+    ThreadPool pool(n_threads);
+    for(size_t i = 0; i < configs.size(); i++)
+    {
+        pool.submit([this, i, &trace_contents, &trace_file_name, sample_fraction, policy_kind, inclusion] ()
+        {
+            const SweepConfig& config = configs[i];
+            CacheSimulator cache_sim(config.l1_size, config.l1_assoc, config.l1_blocksize, config.n_vc_blocks,
+                                     config.l2_size, config.l2_assoc, trace_file_name, policy_kind, inclusion);
+            if(sample_fraction < 1) cache_sim.enableSetSampling(sample_fraction);
+            cache_sim.sendRequests(trace_contents.data(), trace_contents.size());
+            results[i] = cache_sim.getSimulationStats();
+        });
+    }
+    pool.waitAll();
+}
+
+
+void SweepEngine::printResults()
+{
+    cout << "l1_size,l1_assoc,l1_blocksize,vc_num_blocks,l2_size,l2_assoc,"
+         << "l1_reads,l1_read_misses,l1_writes,l1_write_misses,swap_requests,swap_request_rate,swaps,"
+         << "l1_vc_miss_rate,l1_writebacks,l2_reads,l2_read_misses,l2_writes,l2_write_misses,l2_miss_rate,"
+         << "l2_writebacks,total_memory_traffic,average_access_time,energy_delay_product,total_area" << endl;
+
+    cout << fixed << setprecision(4) << dec;
+    for(size_t i = 0; i < configs.size(); i++)
+    {
+        const SweepConfig& config = configs[i];
+        const RawStatistics& raw = results[i].raw_stats;
+        LevelRawStatistics l2 = raw.getLowerLevel(0);
+        const PerformanceStatistics& perf = results[i].perf_stats;
+
+        cout << config.l1_size << "," << config.l1_assoc << "," << config.l1_blocksize << "," << config.n_vc_blocks << ","
+             << config.l2_size << "," << config.l2_assoc << ","
+             << raw.l1_reads << "," << raw.l1_read_misses << "," << raw.l1_writes << "," << raw.l1_write_misses << ","
+             << raw.n_swap_requests << "," << raw.swap_request_rate << "," << raw.n_swaps << ","
+             << raw.l1_vc_miss_rate << "," << raw.l1_writebacks << ","
+             << l2.reads << "," << l2.read_misses << "," << l2.writes << "," << l2.write_misses << ","
+             << l2.miss_rate << "," << l2.writebacks << "," << raw.total_memory_traffic << ","
+             << perf.average_access_time << "," << perf.energy_delay_product << "," << perf.area_metric << endl;
+    }
+}
@@ -0,0 +1,87 @@
+#include "tagMatch.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(CACHE_SCALAR_TAGS)
+#define TAG_MATCH_X86
+#include<immintrin.h>
+#endif
+
+static int findMatchingWayScalar(const uint64_t* tags, const uint64_t* valid_bits, uint n_ways, uint64_t tag)
+{
+    for(uint way = 0; way < n_ways; way++)
+    {
+        if(((valid_bits[way / 64] >> (way % 64)) & 1) && tags[way] == tag) return way;
+    }
+    return -1;
+}
+
+
+#ifdef TAG_MATCH_X86
+__attribute__((target("avx2")))
+static int findMatchingWayAVX2(const uint64_t* tags, const uint64_t* valid_bits, uint n_ways, uint64_t tag)
+{
+    __m256i key = _mm256_set1_epi64x(tag);
+    for(uint way = 0; way < n_ways; way += 4)
+    {
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i*)(tags + way)), key);
+        uint matches = _mm256_movemask_pd(_mm256_castsi256_pd(equal));
+        matches &= (valid_bits[way / 64] >> (way % 64)) & 0xf;
+        if(matches != 0) return way + __builtin_ctz(matches);
+    }
+    return -1;
+}
+
+
+__attribute__((target("sse4.1")))
+static int findMatchingWaySSE(const uint64_t* tags, const uint64_t* valid_bits, uint n_ways, uint64_t tag)
+{
+    __m128i key = _mm_set1_epi64x(tag);
+    for(uint way = 0; way < n_ways; way += 2)
+    {
+        __m128i equal = _mm_cmpeq_epi64(_mm_load_si128((const __m128i*)(tags + way)), key);
+        uint matches = _mm_movemask_pd(_mm_castsi128_pd(equal));
+        matches &= (valid_bits[way / 64] >> (way % 64)) & 0x3;
+        if(matches != 0) return way + __builtin_ctz(matches);
+    }
+    return -1;
+}
+#endif
+
+
+typedef int (*TagMatchKernel)(const uint64_t*, const uint64_t*, uint, uint64_t);
+
+struct TagMatchDispatch
+{
+    TagMatchKernel kernel = findMatchingWayScalar;
+    const char* name = "scalar";
+
+    TagMatchDispatch()
+    {
+#ifdef TAG_MATCH_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+        {
+            kernel = findMatchingWayAVX2;
+            name = "avx2";
+        }
+        else if(__builtin_cpu_supports("sse4.1"))
+        {
+            kernel = findMatchingWaySSE;
+            name = "sse4.1";
+        }
+#endif
+    }
+};
+
+static const TagMatchDispatch tag_match_dispatch;
+
+
+int findMatchingWay(const uint64_t* tags, const uint64_t* valid_bits, uint n_ways, uint64_t tag)
+{
+    return tag_match_dispatch.kernel(tags, valid_bits, n_ways, tag);
+}
+
+
+const char* getTagMatchKernelName()
+{
+    return tag_match_dispatch.name;
+}
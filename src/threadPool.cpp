@@ -0,0 +1,97 @@
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(uint n_threads)
+{
+    n_threads = max(n_threads, 1u);
+    next_queue = 0;
+    n_queued = 0;
+    n_pending = 0;
+    isStopping = false;
+
+    for(uint i = 0; i < n_threads; i++) queues.emplace_back(new WorkerQueue());
+    for(uint i = 0; i < n_threads; i++) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(wait_mutex);
+        isStopping = true;
+    }
+    wake_cv.notify_all();
+
+    for(auto& worker : workers) worker.join();
+}
+
+
+bool ThreadPool::popTask(uint worker, function<void()>& task)
+{
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        WorkerQueue& queue = *queues[(worker + i) % queues.size()];
+        lock_guard<mutex> lock(queue.queue_mutex);
+        if(queue.tasks.empty()) continue;
+
+        if(i == 0)  // own queue
+        {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else        // steal
+        {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        n_queued--;
+        return true;
+    }
+    return false;
+}
+
+
+void ThreadPool::workerLoop(uint worker)
+{
+    while(true)
+    {
+        function<void()> task;
+        if(popTask(worker, task))
+        {
+            task();
+            if(--n_pending == 0)
+            {
+                lock_guard<mutex> lock(wait_mutex);
+                done_cv.notify_all();
+            }
+            continue;
+        }
+
+        unique_lock<mutex> lock(wait_mutex);
+        wake_cv.wait(lock, [this] {return isStopping || n_queued > 0;});
+        if(isStopping && n_queued == 0) return;
+    }
+}
+
+
+void ThreadPool::submit(function<void()> task)
+{
+    WorkerQueue& queue = *queues[next_queue];
+    next_queue = (next_queue + 1) % queues.size();
+
+    n_pending++;
+    n_queued++;
+    {
+        lock_guard<mutex> lock(queue.queue_mutex);
+        queue.tasks.push_back(move(task));
+    }
+
+    lock_guard<mutex> lock(wait_mutex);
+    wake_cv.notify_one();
+}
+
+
+void ThreadPool::waitAll()
+{
+    unique_lock<mutex> lock(wait_mutex);
+    done_cv.wait(lock, [this] {return n_pending == 0;});
+}
@@ -1,52 +1,896 @@
-// #include "trace.h"
-// #define TRACE_DIR_PATH "trace_files/"
-
-// Trace::Trace(string fileName)
-// {
-//     this->traceFileName = fileName;
-// }
-
-
-// vector<TraceEntry> Trace::parseTraceFile()
-// {
-//     vector<TraceEntry> trace_contents;
-//     string traceFilePath = TRACE_DIR_PATH + traceFileName;
-//     ifstream traceFile(traceFilePath);
-
-//     if(traceFile.is_open())
-//     {
-//         while(true)
-//         {
-//             string s1, s2;
-//             traceFile >> s1 >> s2;
-
-//             if(traceFile.fail() && !traceFile.eof())
-//             {
-//                 cerr << "Invalid input or formatting in trace file (Line: " << trace_contents.size()+1 << ")" << endl;
-//                 exit(EXIT_FAILURE);
-//             }
-//             else if(traceFile.eof())
-//             {
-//                 break;
-//             }
-
-//             if(s1 == "r" || s1 == "w")
-//             {
-//                 long long int addr = std::stoull(s2, nullptr, 16);
-//                 TraceEntry newTraceEntry = TraceEntry(s1, addr);
-//                 trace_contents.push_back(newTraceEntry);
-//             }
-//             else
-//             {
-//                 cerr << "Invalid input or formatting in trace file (Line: " << trace_contents.size()+1 << ")" << endl;
-//                 exit(EXIT_FAILURE);                
-//             }
-//         }
-//     }
-//     else
-//     {
-//         cerr << "Error in opening file - " << traceFilePath << endl;
-//     }
-
-//     return trace_contents;
-// }
\ No newline at end of file
+#include "trace.h"
+#include "traceAdapter.h"
+#include<cstring>
+#include<cstdlib>
+#include<thread>
+#include<cerrno>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+// Chunks smaller than this are not worth a thread of their own
+#define MIN_PARSE_CHUNK_SIZE (1 << 20)
+
+// Initial buffer of a streamed trace (grows only for a line or compressed block larger than it)
+#define STREAM_BUFFER_SIZE (1 << 20)
+
+
+/****************************
+ ****** TRACE PARSING *******
+****************************/
+
+size_t Trace::countLines(const char* begin, const char* end)
+{
+    size_t n_lines = 0;
+    const char* p = begin;
+
+    while(p < end)
+    {
+        const char* newline = (const char*) memchr(p, '\n', end - p);
+        n_lines++;
+        if(newline == nullptr) break;
+        p = newline + 1;
+    }
+    return n_lines;
+}
+
+
+size_t Trace::parseChunk(const char* begin, const char* end, TraceEntry* entries, size_t& error_line)
+{
+    size_t n_entries = 0;
+    size_t line = 0;
+    const char* p = begin;
+    error_line = 0;
+
+    while(p < end)
+    {
+        line++;
+        while(p < end && isBlank(*p)) p++;
+
+        if(p == end) break;
+        if(*p == '\n')  // blank line
+        {
+            p++;
+            continue;
+        }
+
+        // Operation: a single `r` or `w` followed by blanks
+        char op = *p++;
+        if((op != 'r' && op != 'w') || p == end || !isBlank(*p))
+        {
+            error_line = line;
+            return n_entries;
+        }
+        while(p < end && isBlank(*p)) p++;
+
+        // Address: hex digits with an optional 0x prefix
+        unsigned long long int addr;
+        bool isValidLine = parseHex(p, end, addr);
+
+        while(p < end && isBlank(*p)) p++;
+
+        // Optional access size (decimal) and PC (hex)
+        uint32_t access_size = 0;
+        unsigned long long int pc = 0;
+        if(isValidLine && p < end && *p != '\n')
+        {
+            isValidLine = (*p >= '0' && *p <= '9');
+            while(p < end && *p >= '0' && *p <= '9') access_size = access_size * 10 + (*p++ - '0');
+            while(p < end && isBlank(*p)) p++;
+
+            if(isValidLine && p < end && *p != '\n')
+            {
+                isValidLine = parseHex(p, end, pc);
+                while(p < end && isBlank(*p)) p++;
+            }
+        }
+
+        if(!isValidLine || (p < end && *p != '\n'))
+        {
+            error_line = line;
+            return n_entries;
+        }
+        p++;    // newline
+
+        entries[n_entries].addr = addr;
+        entries[n_entries].operation = op;
+        entries[n_entries].size = access_size;
+        entries[n_entries].pc = pc;
+        n_entries++;
+    }
+    return n_entries;
+}
+
+
+size_t Trace::decodeRecords(const char* first_record, size_t n_records, TraceEntry* entries)
+{
+    size_t record_size = binaryRecordSize();
+    const unsigned char* record = (const unsigned char*) first_record;
+
+    for(size_t i = 0; i < n_records; i++, record += record_size)
+    {
+        if(record[0] > 1) return i;
+
+        if(binary_header.addr_width == 4)
+        {
+            uint32_t addr;
+            memcpy(&addr, record + 1, sizeof(addr));
+            entries[i].addr = addr;
+        }
+        else
+        {
+            uint64_t addr;
+            memcpy(&addr, record + 1, sizeof(addr));
+            entries[i].addr = addr;
+        }
+        entries[i].operation = (record[0] == 0) ? 'r' : 'w';
+        entries[i].size = 0;
+        entries[i].pc = 0;
+    }
+    return n_records;
+}
+
+
+bool Trace::decodeCompressedRecords(const unsigned char*& pos, const unsigned char* end, size_t n_records,
+                                    uint64_t& prev_addr, TraceEntry* entries)
+{
+    for(size_t i = 0; i < n_records; i++)
+    {
+        // varint of up to 65 bits: low 64 bits + the 65th bit
+        uint64_t low = 0;
+        uint64_t high = 0;
+        int shift = 0;
+
+        while(true)
+        {
+            if(pos == end) return false;
+            unsigned char byte = *pos++;
+
+            low |= (uint64_t)(byte & 0x7f) << shift;
+            if(shift == 63) high = (byte & 0x7f) >> 1;
+
+            if((byte & 0x80) == 0) break;
+            shift += 7;
+            if(shift > 63) return false;
+        }
+
+        uint64_t zigzag_delta = (low >> 1) | (high << 63);
+        uint64_t delta = (zigzag_delta >> 1) ^ (0 - (zigzag_delta & 1));
+        prev_addr += delta;
+
+        entries[i].addr = prev_addr;
+        entries[i].operation = (low & 1) ? 'w' : 'r';
+        entries[i].size = 0;
+        entries[i].pc = 0;
+    }
+    return true;
+}
+
+
+const char* Trace::nextCompressedBlock(const char* block, CompressedBlockHeader& block_header, size_t block_index)
+{
+    const char* end = data + size;
+
+    if((size_t)(end - block) < sizeof(CompressedBlockHeader))
+    {
+        cerr << "Truncated compressed trace file (Block: " << block_index + 1 << ")" << endl;
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&block_header, block, sizeof(block_header));
+
+    const char* payload = block + sizeof(CompressedBlockHeader);
+    if((size_t)(end - payload) < block_header.payload_bytes)
+    {
+        cerr << "Truncated compressed trace file (Block: " << block_index + 1 << ")" << endl;
+        exit(EXIT_FAILURE);
+    }
+    return payload;
+}
+
+
+bool parseTraceFormat(const string& name, TraceFormat& format)
+{
+    static const pair<const char*, TraceFormat> format_names[] =
+    {
+        {"auto", TraceFormat::AUTO},
+        {"text", TraceFormat::TEXT},
+        {"binary", TraceFormat::BINARY},
+        {"compressed", TraceFormat::COMPRESSED},
+        {"din", TraceFormat::DINERO},
+        {"lackey", TraceFormat::LACKEY},
+        {"champsim", TraceFormat::CHAMPSIM}
+    };
+
+    for(auto& format_name : format_names)
+    {
+        if(name == format_name.first)
+        {
+            format = format_name.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/****************************
+ *** TRACE (MMAP / STREAM) **
+****************************/
+
+Trace::Trace(string filePath, TraceFormat requested_format, bool isIFetchIncluded)
+{
+    traceFilePath = filePath;
+    fd = -1;
+    data = nullptr;
+    size = 0;
+    isFileOpen = false;
+    format = TraceFormat::TEXT;
+    this->isIFetchIncluded = isIFetchIncluded;
+    records = nullptr;
+    cursor = nullptr;
+    n_lines_read = 0;
+    n_records_read = 0;
+    isStream = false;
+    isStreamEOF = false;
+    block_pos = nullptr;
+    block_end = nullptr;
+    block_remaining = 0;
+    block_prev_addr = 0;
+    n_blocks_read = 0;
+
+    fd = (filePath == "-") ? dup(STDIN_FILENO) : open(filePath.c_str(), O_RDONLY);
+    if(fd < 0) return;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    isFileOpen = true;
+
+    if(!S_ISREG(file_stat.st_mode))     // stdin, named pipe, ...
+    {
+        isStream = true;
+        stream_buffer.resize(STREAM_BUFFER_SIZE);
+        data = stream_buffer.data();
+        cursor = data;
+
+        ensureAvailable(sizeof(CompressedTraceHeader));     // enough to detect the format
+        detectFormat(requested_format);
+        cursor = records;
+        return;
+    }
+
+    size = file_stat.st_size;
+
+    if(size == 0) return;   // mmap does not accept empty mappings
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapping == MAP_FAILED)
+    {
+        isFileOpen = false;
+        size = 0;
+        return;
+    }
+    madvise(mapping, size, MADV_WILLNEED);
+    data = (const char*) mapping;
+
+    detectFormat(requested_format);
+    cursor = records;
+}
+
+
+bool Trace::refillStream()
+{
+    if(!isStream || isStreamEOF) return false;
+
+    size_t n_unread = data + size - cursor;
+    memmove(stream_buffer.data(), cursor, n_unread);
+    if(n_unread == stream_buffer.size()) stream_buffer.resize(2 * stream_buffer.size());
+
+    ssize_t n_bytes;
+    do
+    {
+        n_bytes = read(fd, stream_buffer.data() + n_unread, stream_buffer.size() - n_unread);
+    } while(n_bytes < 0 && errno == EINTR);
+
+    if(n_bytes < 0) cerr << "Error in reading trace stream - " << traceFilePath << endl;
+    if(n_bytes <= 0) isStreamEOF = true;
+
+    data = stream_buffer.data();
+    size = n_unread + max<ssize_t>(n_bytes, 0);
+    cursor = data;
+    return true;
+}
+
+
+bool Trace::ensureAvailable(size_t n_bytes)
+{
+    while((size_t)(data + size - cursor) < n_bytes)
+    {
+        if(!refillStream()) return false;
+    }
+    return true;
+}
+
+
+void Trace::detectFormat(TraceFormat requested_format)
+{
+    records = data;
+
+    if(size >= sizeof(CompressedTraceHeader) && memcmp(data, COMPRESSED_TRACE_MAGIC, sizeof(compressed_header.magic)) == 0)
+    {
+        format = TraceFormat::COMPRESSED;
+        memcpy(&compressed_header, data, sizeof(compressed_header));
+        records = data + sizeof(CompressedTraceHeader);
+
+        if(compressed_header.version != COMPRESSED_TRACE_VERSION)
+        {
+            cerr << "Invalid compressed trace file header - " << traceFilePath << endl;
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    if(size < sizeof(BinaryTraceHeader) || memcmp(data, BINARY_TRACE_MAGIC, sizeof(binary_header.magic)) != 0)
+    {
+        // No header: the format is given, or guessed from the first line / record
+        format = requested_format;
+        if(format == TraceFormat::AUTO || format == TraceFormat::BINARY || format == TraceFormat::COMPRESSED)
+        {
+            const char* end = data + size;
+            if(ChampSimTraceAdapter::matches(data, end)) format = TraceFormat::CHAMPSIM;
+            else if(LackeyTraceAdapter::matches(data, end)) format = TraceFormat::LACKEY;
+            else if(DineroTraceAdapter::matches(data, end)) format = TraceFormat::DINERO;
+            else format = TraceFormat::TEXT;
+        }
+
+        if(format == TraceFormat::DINERO) adapter.reset(new DineroTraceAdapter(isIFetchIncluded));
+        else if(format == TraceFormat::LACKEY) adapter.reset(new LackeyTraceAdapter(isIFetchIncluded));
+        else if(format == TraceFormat::CHAMPSIM) adapter.reset(new ChampSimTraceAdapter(isIFetchIncluded));
+        return;
+    }
+
+    format = TraceFormat::BINARY;
+    memcpy(&binary_header, data, sizeof(binary_header));
+    records = data + sizeof(BinaryTraceHeader);
+
+    // The record count is checked by a division: multiplied, a crafted count could wrap around to the file size
+    size_t n_recordBytes = size - sizeof(BinaryTraceHeader);
+    bool isValidHeader = binary_header.version == BINARY_TRACE_VERSION &&
+                         (binary_header.addr_width == 4 || binary_header.addr_width == 8) &&
+                         (isStream || (n_recordBytes % binaryRecordSize() == 0 &&
+                                       binary_header.n_records == n_recordBytes / binaryRecordSize()));
+    if(!isValidHeader)
+    {
+        cerr << "Invalid binary trace file header - " << traceFilePath << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+Trace::~Trace()
+{
+    if(!isStream && data != nullptr) munmap((void*) data, size);
+    if(fd >= 0) close(fd);
+}
+
+
+vector<TraceEntry> Trace::parseTraceFile(uint n_threads)
+{
+    vector<TraceEntry> trace_contents;
+    if(data == nullptr) return trace_contents;
+
+    if(adapter || isStream)
+    {
+        // Streams cannot be split up front and records of foreign formats decode to a varying number of accesses,
+        // decode them in order
+        vector<TraceEntry> batch(TRACE_BATCH_SIZE);
+        size_t n_entries;
+        while((n_entries = readBatch(batch.data(), batch.size())) > 0)
+        {
+            trace_contents.insert(trace_contents.end(), batch.begin(), batch.begin() + n_entries);
+        }
+        return trace_contents;
+    }
+
+    if(format == TraceFormat::BINARY)
+    {
+        size_t n_records = binary_header.n_records;
+        size_t max_chunks = max<size_t>(1, n_records * binaryRecordSize() / MIN_PARSE_CHUNK_SIZE);
+        uint n_chunks = (uint) min<size_t>(max(n_threads, 1u), max_chunks);
+
+        trace_contents.resize(n_records);
+        vector<size_t> chunk_error(n_chunks);
+
+        auto decodeChunk = [&](uint i)
+        {
+            size_t first = (n_records * i) / n_chunks;
+            size_t last = (n_records * (i + 1)) / n_chunks;
+            size_t n_valid = decodeRecords(records + first * binaryRecordSize(), last - first, trace_contents.data() + first);
+            chunk_error[i] = (n_valid == last - first) ? n_records : first + n_valid;
+        };
+
+        vector<thread> workers;
+        for(uint i = 1; i < n_chunks; i++) workers.emplace_back(decodeChunk, i);
+        decodeChunk(0);
+        for(auto& worker : workers) worker.join();
+
+        for(uint i = 0; i < n_chunks; i++)
+        {
+            if(chunk_error[i] != n_records)
+            {
+                cerr << "Invalid record in binary trace file (Record: " << chunk_error[i] + 1 << ")" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        return trace_contents;
+    }
+
+    if(format == TraceFormat::COMPRESSED)
+    {
+        // Block headers give every block its slot in the flat output array
+        size_t n_blocks = compressed_header.n_blocks;
+        vector<CompressedBlockHeader> block_headers(n_blocks);
+        vector<const char*> block_payload(n_blocks);
+        vector<size_t> block_offset(n_blocks + 1, 0);
+
+        const char* block = records;
+        for(size_t i = 0; i < n_blocks; i++)
+        {
+            block_payload[i] = nextCompressedBlock(block, block_headers[i], i);
+            block_offset[i+1] = block_offset[i] + block_headers[i].n_records;
+            block = block_payload[i] + block_headers[i].payload_bytes;
+        }
+
+        if(block_offset[n_blocks] != compressed_header.n_records)
+        {
+            cerr << "Invalid compressed trace file header - " << traceFilePath << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        trace_contents.resize(compressed_header.n_records);
+        uint n_chunks = (uint) max<size_t>(1, min<size_t>(max(n_threads, 1u), n_blocks));
+        vector<size_t> chunk_error_block(n_chunks, 0);
+
+        auto decodeChunk = [&](uint c)
+        {
+            for(size_t i = (n_blocks * c) / n_chunks; i < (n_blocks * (c + 1)) / n_chunks; i++)
+            {
+                const unsigned char* pos = (const unsigned char*) block_payload[i];
+                const unsigned char* payload_end = pos + block_headers[i].payload_bytes;
+                uint64_t prev_addr = 0;
+
+                if(!decodeCompressedRecords(pos, payload_end, block_headers[i].n_records, prev_addr, trace_contents.data() + block_offset[i]) ||
+                   pos != payload_end)
+                {
+                    chunk_error_block[c] = i + 1;
+                    return;
+                }
+            }
+        };
+
+        vector<thread> workers;
+        for(uint c = 1; c < n_chunks; c++) workers.emplace_back(decodeChunk, c);
+        decodeChunk(0);
+        for(auto& worker : workers) worker.join();
+
+        for(uint c = 0; c < n_chunks; c++)
+        {
+            if(chunk_error_block[c] != 0)
+            {
+                cerr << "Corrupt block in compressed trace file (Block: " << chunk_error_block[c] << ")" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        return trace_contents;
+    }
+
+    const char* end = data + size;
+
+    // 1. Split the file into chunks at newline boundaries
+    size_t max_chunks = max<size_t>(1, size / MIN_PARSE_CHUNK_SIZE);
+    uint n_chunks = (uint) min<size_t>(max(n_threads, 1u), max_chunks);
+
+    vector<const char*> chunk_begin(n_chunks + 1);
+    chunk_begin[0] = data;
+    chunk_begin[n_chunks] = end;
+
+    for(uint i = 1; i < n_chunks; i++)
+    {
+        const char* p = max(data + (size * i) / n_chunks, chunk_begin[i-1]);
+        const char* newline = (const char*) memchr(p, '\n', end - p);
+        chunk_begin[i] = (newline == nullptr) ? end : newline + 1;
+    }
+
+    auto runOnChunks = [&](auto chunkFunction)
+    {
+        vector<thread> workers;
+        for(uint i = 1; i < n_chunks; i++) workers.emplace_back(chunkFunction, i);
+        chunkFunction(0);
+        for(auto& worker : workers) worker.join();
+    };
+
+    // 2. Lines per chunk give each chunk its slot in the flat output array
+    vector<size_t> chunk_lines(n_chunks);
+    runOnChunks([&](uint i) { chunk_lines[i] = countLines(chunk_begin[i], chunk_begin[i+1]); });
+
+    vector<size_t> chunk_offset(n_chunks + 1, 0);
+    for(uint i = 0; i < n_chunks; i++) chunk_offset[i+1] = chunk_offset[i] + chunk_lines[i];
+
+    // 3. Decode every chunk in place
+    trace_contents.resize(chunk_offset[n_chunks]);
+    vector<size_t> chunk_entries(n_chunks);
+    vector<size_t> chunk_error_line(n_chunks);
+
+    runOnChunks([&](uint i)
+    {
+        chunk_entries[i] = parseChunk(chunk_begin[i], chunk_begin[i+1], trace_contents.data() + chunk_offset[i], chunk_error_line[i]);
+    });
+
+    for(uint i = 0; i < n_chunks; i++)
+    {
+        if(chunk_error_line[i] != 0)
+        {
+            cerr << "Invalid input or formatting in trace file (Line: " << chunk_offset[i] + chunk_error_line[i] << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // 4. Blank lines leave gaps at the end of their chunk's slot
+    size_t n_entries = chunk_entries[0];
+    for(uint i = 1; i < n_chunks; i++)
+    {
+        if(n_entries != chunk_offset[i])
+        {
+            memmove(trace_contents.data() + n_entries, trace_contents.data() + chunk_offset[i], chunk_entries[i] * sizeof(TraceEntry));
+        }
+        n_entries += chunk_entries[i];
+    }
+    trace_contents.resize(n_entries);
+
+    return trace_contents;
+}
+
+
+size_t Trace::readAdapterBatch(TraceEntry* entries, size_t max_entries)
+{
+    size_t record_size = adapter->getRecordSize();
+    size_t n_entries = 0;
+
+    while(n_entries + adapter->getMaxEntriesPerRecord() <= max_entries)
+    {
+        const char* record_end;
+        const char* next_record;
+
+        if(record_size > 0)
+        {
+            if(!ensureAvailable(record_size))
+            {
+                if(cursor != data + size)
+                {
+                    cerr << "Truncated " << adapter->getName() << " trace file (Record: " << n_records_read + 1 << ")" << endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            record_end = cursor + record_size;
+            next_record = record_end;
+        }
+        else
+        {
+            const char* end = data + size;
+            const char* newline = (const char*) memchr(cursor, '\n', end - cursor);
+            if(newline == nullptr)
+            {
+                if(refillStream()) continue;    // rest of the line is still to be read
+                if(cursor == end) break;
+                record_end = end;
+                next_record = end;
+            }
+            else
+            {
+                record_end = newline;
+                next_record = newline + 1;
+            }
+        }
+
+        size_t n_record_entries;
+        if(!adapter->decodeRecord(cursor, record_end, entries + n_entries, n_record_entries))
+        {
+            cerr << "Invalid input or formatting in " << adapter->getName() << " trace file ("
+                 << ((record_size > 0) ? "Record: " : "Line: ") << n_records_read + 1 << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        n_entries += n_record_entries;
+        n_records_read++;
+        cursor = next_record;
+    }
+    return n_entries;
+}
+
+
+size_t Trace::readBatch(TraceEntry* entries, size_t max_entries)
+{
+    if(data == nullptr || max_entries == 0) return 0;
+
+    if(adapter) return readAdapterBatch(entries, max_entries);
+
+    if(format == TraceFormat::COMPRESSED)
+    {
+        // Decompressed block by block, straight into the caller's batch
+        size_t n_entries = 0;
+
+        while(n_entries < max_entries)
+        {
+            if(block_remaining == 0)
+            {
+                if(!isStream && n_blocks_read == compressed_header.n_blocks) break;
+                if(isStream && !ensureAvailable(1)) break;
+
+                // A streamed block is buffered whole before it is decoded
+                CompressedBlockHeader block_header;
+                if(isStream && ensureAvailable(sizeof(CompressedBlockHeader)))
+                {
+                    memcpy(&block_header, cursor, sizeof(block_header));
+                    ensureAvailable(sizeof(CompressedBlockHeader) + block_header.payload_bytes);
+                }
+
+                block_pos = (const unsigned char*) nextCompressedBlock(cursor, block_header, n_blocks_read);
+                block_end = block_pos + block_header.payload_bytes;
+                block_remaining = block_header.n_records;
+                block_prev_addr = 0;
+                cursor = (const char*) block_end;
+                n_blocks_read++;
+                continue;
+            }
+
+            size_t n_records = min<size_t>(max_entries - n_entries, block_remaining);
+            bool isValidBlock = decodeCompressedRecords(block_pos, block_end, n_records, block_prev_addr, entries + n_entries);
+            block_remaining -= n_records;
+            n_entries += n_records;
+
+            if(!isValidBlock || (block_remaining == 0 && block_pos != block_end))
+            {
+                cerr << "Corrupt block in compressed trace file (Block: " << n_blocks_read << ")" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        return n_entries;
+    }
+
+    if(format == TraceFormat::BINARY)
+    {
+        size_t record_size = binaryRecordSize();
+        size_t n_records;
+
+        if(isStream)
+        {
+            if(!ensureAvailable(record_size))
+            {
+                if(cursor != data + size)
+                {
+                    cerr << "Truncated binary trace file (Record: " << n_records_read + 1 << ")" << endl;
+                    exit(EXIT_FAILURE);
+                }
+                return 0;
+            }
+            n_records = min<size_t>(max_entries, (data + size - cursor) / record_size);
+        }
+        else
+        {
+            n_records = min<size_t>(max_entries, binary_header.n_records - n_records_read);
+        }
+
+        size_t n_valid = decodeRecords(cursor, n_records, entries);
+        if(n_valid != n_records)
+        {
+            cerr << "Invalid record in binary trace file (Record: " << n_records_read + n_valid + 1 << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+        cursor += n_records * record_size;
+        n_records_read += n_records;
+        return n_records;
+    }
+
+    size_t n_entries = 0;
+
+    // A batch of only blank lines decodes to nothing, keep going until something is decoded
+    while(n_entries == 0)
+    {
+        const char* end = data + size;
+        const char* chunk_end = cursor;
+        size_t n_lines = 0;
+
+        while(n_lines < max_entries && chunk_end < end)
+        {
+            const char* newline = (const char*) memchr(chunk_end, '\n', end - chunk_end);
+            if(newline == nullptr)
+            {
+                if(isStream && !isStreamEOF) break;     // rest of the line is still to be read
+                chunk_end = end;
+            }
+            else
+            {
+                chunk_end = newline + 1;
+            }
+            n_lines++;
+        }
+
+        if(n_lines == 0)
+        {
+            if(!refillStream()) break;
+            continue;
+        }
+
+        size_t error_line;
+        n_entries = parseChunk(cursor, chunk_end, entries, error_line);
+
+        if(error_line != 0)
+        {
+            cerr << "Invalid input or formatting in trace file (Line: " << n_lines_read + error_line << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        n_lines_read += n_lines;
+        cursor = chunk_end;
+    }
+    return n_entries;
+}
+
+
+/****************************
+ *** BINARY TRACE WRITER ****
+****************************/
+
+// Records are buffered and written in blocks of this size
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+BinaryTraceWriter::BinaryTraceWriter(string filePath, uint addr_width)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic));
+    header.version = BINARY_TRACE_VERSION;
+    header.addr_width = addr_width;
+    header.n_records = 0;
+
+    buffer.reserve(WRITER_BUFFER_SIZE);
+
+    file = fopen(filePath.c_str(), "wb");
+    if(file != nullptr && fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+
+BinaryTraceWriter::~BinaryTraceWriter()
+{
+    if(file != nullptr) close();
+}
+
+
+void BinaryTraceWriter::flushBuffer()
+{
+    if(!buffer.empty()) fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+}
+
+
+void BinaryTraceWriter::write(const TraceEntry& entry)
+{
+    if(buffer.size() + 1 + header.addr_width > WRITER_BUFFER_SIZE) flushBuffer();
+
+    buffer.push_back(entry.operation == 'w' ? 1 : 0);
+
+    uint64_t addr = entry.addr;
+    for(uint i = 0; i < header.addr_width; i++)
+    {
+        buffer.push_back((addr >> (8 * i)) & 0xff);
+    }
+    header.n_records++;
+}
+
+
+bool BinaryTraceWriter::close()
+{
+    if(file == nullptr) return false;
+
+    flushBuffer();
+    bool isWritten = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    isWritten = (ferror(file) == 0) && isWritten;
+    isWritten = (fclose(file) == 0) && isWritten;
+    file = nullptr;
+    return isWritten;
+}
+
+
+/****************************
+ * COMPRESSED TRACE WRITER **
+****************************/
+
+CompressedTraceWriter::CompressedTraceWriter(string filePath, uint32_t max_block_records)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPRESSED_TRACE_MAGIC, sizeof(header.magic));
+    header.version = COMPRESSED_TRACE_VERSION;
+    header.block_records = max_block_records;
+
+    block_records = 0;
+    prev_addr = 0;
+    block.reserve(max_block_records * 4);
+
+    file = fopen(filePath.c_str(), "wb");
+    if(file != nullptr && fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+
+CompressedTraceWriter::~CompressedTraceWriter()
+{
+    if(file != nullptr) close();
+}
+
+
+void CompressedTraceWriter::flushBlock()
+{
+    if(block_records == 0) return;
+
+    CompressedBlockHeader block_header;
+    block_header.payload_bytes = block.size();
+    block_header.n_records = block_records;
+
+    fwrite(&block_header, sizeof(block_header), 1, file);
+    fwrite(block.data(), 1, block.size(), file);
+    header.n_blocks++;
+
+    block.clear();
+    block_records = 0;
+    prev_addr = 0;
+}
+
+
+void CompressedTraceWriter::write(const TraceEntry& entry)
+{
+    uint64_t addr = entry.addr;
+    int64_t delta = (int64_t)(addr - prev_addr);
+    uint64_t zigzag_delta = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    prev_addr = addr;
+
+    // varint of up to 65 bits: low 64 bits + the 65th bit
+    uint64_t low = (zigzag_delta << 1) | (entry.operation == 'w' ? 1 : 0);
+    uint64_t high = zigzag_delta >> 63;
+
+    while(high != 0 || low >= 0x80)
+    {
+        block.push_back((low & 0x7f) | 0x80);
+        low = (low >> 7) | (high << 57);
+        high = 0;
+    }
+    block.push_back(low);
+
+    header.n_records++;
+    if(++block_records == header.block_records) flushBlock();
+}
+
+
+bool CompressedTraceWriter::close()
+{
+    if(file == nullptr) return false;
+
+    flushBlock();
+    bool isWritten = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    isWritten = (ferror(file) == 0) && isWritten;
+    isWritten = (fclose(file) == 0) && isWritten;
+    file = nullptr;
+    return isWritten;
+}
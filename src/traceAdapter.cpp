@@ -0,0 +1,190 @@
+#include "traceAdapter.h"
+#include<cstring>
+
+/*
+ * @return end of the first line of [begin, end)
+ */
+static const char* firstLineEnd(const char* begin, const char* end)
+{
+    const char* newline = (const char*) memchr(begin, '\n', end - begin);
+    return (newline == nullptr) ? end : newline;
+}
+
+
+static inline void skipBlanks(const char*& p, const char* end)
+{
+    while(p < end && isBlank(*p)) p++;
+}
+
+
+/****************************
+ ****** DINERO (din) ********
+****************************/
+
+bool DineroTraceAdapter::decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries)
+{
+    const char* p = begin;
+    n_entries = 0;
+
+    skipBlanks(p, end);
+    if(p == end) return true;   // blank line
+
+    int label = *p++ - '0';
+    if(label < 0 || label > 9 || p == end || !isBlank(*p)) return false;
+    skipBlanks(p, end);
+
+    unsigned long long int addr;
+    if(!parseHex(p, end, addr)) return false;
+    if(p < end && !isBlank(*p)) return false;
+
+    switch(label)
+    {
+        case 0:     // data read
+            entries[0] = {(long long int) addr, 'r', 0, 0};
+            n_entries = 1;
+            break;
+        case 1:     // data write
+            entries[0] = {(long long int) addr, 'w', 0, 0};
+            n_entries = 1;
+            break;
+        case 2:     // instruction fetch
+            if(isIFetchIncluded)
+            {
+                entries[0] = {(long long int) addr, 'r', 0, 0};
+                n_entries = 1;
+            }
+            break;
+        case 3:     // escape
+        case 4:     // cache flush
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+
+bool DineroTraceAdapter::matches(const char* begin, const char* end)
+{
+    const char* p = begin;
+    end = firstLineEnd(begin, end);
+
+    skipBlanks(p, end);
+    if(end - p < 3 || *p < '0' || *p > '4' || !isBlank(p[1])) return false;
+    p++;
+    skipBlanks(p, end);
+
+    unsigned long long int addr;
+    return parseHex(p, end, addr);
+}
+
+
+/****************************
+ ***** VALGRIND LACKEY ******
+****************************/
+
+bool LackeyTraceAdapter::decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries)
+{
+    const char* p = begin;
+    n_entries = 0;
+
+    if(end - p >= 2 && p[0] == '=' && p[1] == '=') return true;    // valgrind output
+
+    skipBlanks(p, end);
+    if(p == end) return true;   // blank line
+
+    char op = *p++;
+    if(p == end || !isBlank(*p)) return false;
+    skipBlanks(p, end);
+
+    unsigned long long int addr;
+    if(!parseHex(p, end, addr)) return false;
+
+    // Access size (decimal)
+    if(p == end || *p != ',') return false;
+    p++;
+    if(p == end || *p < '0' || *p > '9') return false;
+    uint32_t access_size = 0;
+    while(p < end && *p >= '0' && *p <= '9') access_size = access_size * 10 + (*p++ - '0');
+
+    skipBlanks(p, end);
+    if(p != end) return false;
+
+    switch(op)
+    {
+        case 'I':
+            last_ifetch_addr = addr;
+            if(isIFetchIncluded) entries[n_entries++] = {(long long int) addr, 'r', access_size, addr};
+            break;
+        case 'L':
+            entries[n_entries++] = {(long long int) addr, 'r', access_size, last_ifetch_addr};
+            break;
+        case 'S':
+            entries[n_entries++] = {(long long int) addr, 'w', access_size, last_ifetch_addr};
+            break;
+        case 'M':
+            entries[n_entries++] = {(long long int) addr, 'r', access_size, last_ifetch_addr};
+            entries[n_entries++] = {(long long int) addr, 'w', access_size, last_ifetch_addr};
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+
+bool LackeyTraceAdapter::matches(const char* begin, const char* end)
+{
+    const char* p = begin;
+    end = firstLineEnd(begin, end);
+
+    if(end - p >= 2 && p[0] == '=' && p[1] == '=') return true;
+
+    skipBlanks(p, end);
+    if(end - p < 3 || strchr("ILSM", *p) == nullptr || !isBlank(p[1])) return false;
+    p++;
+    skipBlanks(p, end);
+
+    unsigned long long int addr;
+    return parseHex(p, end, addr) && p < end && *p == ',';
+}
+
+
+/****************************
+ ******** CHAMPSIM **********
+****************************/
+
+bool ChampSimTraceAdapter::decodeRecord(const char* begin, const char* end, TraceEntry* entries, size_t& n_entries)
+{
+    // A truncated record is malformed
+    if(end - begin < (ptrdiff_t) sizeof(ChampSimRecord)) return false;
+
+    ChampSimRecord record;
+    memcpy(&record, begin, sizeof(record));
+    n_entries = 0;
+
+    if(isIFetchIncluded) entries[n_entries++] = {(long long int) record.ip, 'r', 0, record.ip};
+
+    for(uint64_t addr : record.source_memory)
+    {
+        if(addr != 0) entries[n_entries++] = {(long long int) addr, 'r', 0, record.ip};
+    }
+    for(uint64_t addr : record.destination_memory)
+    {
+        if(addr != 0) entries[n_entries++] = {(long long int) addr, 'w', 0, record.ip};
+    }
+    return true;
+}
+
+
+bool ChampSimTraceAdapter::matches(const char* begin, const char* end)
+{
+    end = min(end, begin + sizeof(ChampSimRecord));
+
+    for(const char* p = begin; p < end; p++)
+    {
+        unsigned char c = *p;
+        if((c < 0x20 && c != '\n' && c != '\t' && c != '\r') || c >= 0x7f) return true;
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#include "trace.h"
+#include<cstdlib>
+#include<cstring>
+#include<memory>
+
+// Entries decoded per readBatch call
+#define CONVERT_BATCH_SIZE 4096
+
+/*
+ * Converts a trace (text, binary or compressed) into the binary or the compressed trace format.
+ *
+ * Usage: ./trace_convert [--compressed] <input_trace_path> <output_trace_path>
+ *
+ * The input may be "-" for stdin or a named pipe.
+ */
+int main(int argc, char* argv[])
+{
+    bool isCompressed = (argc == 4 && strcmp(argv[1], "--compressed") == 0);
+
+    if(argc != 3 && !isCompressed)
+    {
+        cout << "Usage: " << argv[0] << " [--compressed] <input_trace_path> <output_trace_path>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    string inputPath = argv[argc - 2];
+    string outputPath = argv[argc - 1];
+    vector<TraceEntry> batch(CONVERT_BATCH_SIZE);
+    size_t n_entries;
+
+    Trace trace(inputPath);
+    if(!trace.isOpen())
+    {
+        cerr << "Error in opening file - " << inputPath << endl;
+        return EXIT_FAILURE;
+    }
+
+    // 1. Find the address width the trace needs (binary format only). A stream (stdin / pipe) can only be read
+    //    once: it is converted in one pass with 8 byte addresses
+    uint addr_width = trace.isStreamed() ? 8 : 4;
+    if(!isCompressed && !trace.isStreamed())
+    {
+        Trace scan(inputPath);
+        while((n_entries = scan.readBatch(batch.data(), batch.size())) > 0)
+        {
+            for(size_t i = 0; i < n_entries; i++)
+            {
+                if((unsigned long long int) batch[i].addr > UINT32_MAX) addr_width = 8;
+            }
+        }
+    }
+
+    // 2. Write the records
+    unique_ptr<TraceWriter> writer;
+    if(isCompressed)
+        writer.reset(new CompressedTraceWriter(outputPath));
+    else
+        writer.reset(new BinaryTraceWriter(outputPath, addr_width));
+
+    if(!writer->isOpen())
+    {
+        cerr << "Error in opening file - " << outputPath << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t n_records = 0;
+    while((n_entries = trace.readBatch(batch.data(), batch.size())) > 0)
+    {
+        for(size_t i = 0; i < n_entries; i++) writer->write(batch[i]);
+        n_records += n_entries;
+    }
+
+    if(!writer->close())
+    {
+        cerr << "Error in writing file - " << outputPath << endl;
+        return EXIT_FAILURE;
+    }
+
+    if(isCompressed)
+        cout << "Converted " << n_records << " accesses to compressed trace " << outputPath << endl;
+    else
+        cout << "Converted " << n_records << " accesses (" << addr_width << " byte addresses) to " << outputPath << endl;
+    return 0;
+}
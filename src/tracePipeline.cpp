@@ -0,0 +1,63 @@
+#include "tracePipeline.h"
+#include<thread>
+
+void PipelineStatistics::printStats()
+{
+    cerr << endl;
+    cerr << "===== Trace pipeline =====" << endl;
+    cerr << "  batches:\t\t" << n_batches << endl;
+    cerr << "  accesses:\t\t" << n_accesses << endl;
+    cerr << "  reader stalls (ring full):\t\t" << n_reader_stalls << endl;
+    cerr << "  simulator stalls (ring empty):\t\t" << n_simulator_stalls << endl;
+}
+
+
+TracePipeline::TracePipeline() : ring(PIPELINE_RING_BATCHES)
+{
+}
+
+
+void TracePipeline::readTrace(Trace& trace)
+{
+    while(true)
+    {
+        TraceBatch* batch = ring.tryAcquireWrite();
+        if(batch == nullptr)
+        {
+            pipeline_stats.n_reader_stalls++;
+            while((batch = ring.tryAcquireWrite()) == nullptr) this_thread::yield();
+        }
+
+        batch->n_entries = trace.readBatch(batch->entries, TRACE_BATCH_SIZE);
+        ring.publishWrite();
+
+        if(batch->n_entries == 0) break;
+    }
+}
+
+
+void TracePipeline::run(Trace& trace, CacheSimulator& cache_sim, ProgressReporter& progress)
+{
+    thread reader(&TracePipeline::readTrace, this, ref(trace));
+
+    while(true)
+    {
+        TraceBatch* batch = ring.tryAcquireRead();
+        if(batch == nullptr)
+        {
+            pipeline_stats.n_simulator_stalls++;
+            while((batch = ring.tryAcquireRead()) == nullptr) this_thread::yield();
+        }
+
+        size_t n_entries = batch->n_entries;
+        cache_sim.sendRequests(batch->entries, n_entries);
+        ring.releaseRead();
+
+        if(n_entries == 0) break;
+        pipeline_stats.n_batches++;
+        pipeline_stats.n_accesses += n_entries;
+        progress.update(n_entries);
+    }
+
+    reader.join();
+}